@@ -0,0 +1,68 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/*
+  Minimal timing helpers for the microbenchmarks. A kernel is called repeatedly until at
+  least `min_time` seconds have passed; the reported time per call is the mean over all
+  calls. Throughput is derived from the number of sites a call processes and the number
+  of bytes it reads and writes (a lower bound on the memory traffic).
+ */
+namespace benchmark {
+
+// Keeps the compiler from optimising away the computation of `value`
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct measurement {
+  std::size_t calls;
+  double seconds_per_call;
+};
+
+template <typename Kernel>
+measurement measure(Kernel &&kernel, double min_time = 0.05, std::size_t min_calls = 3) {
+  using clock = std::chrono::steady_clock;
+
+  kernel(); // Warm up caches and buffers
+
+  std::size_t calls = 0;
+  std::size_t batch = 1;
+  double elapsed    = 0;
+  const auto start  = clock::now();
+  while (elapsed < min_time || calls < min_calls) {
+    for (std::size_t i = 0; i < batch; ++i)
+      kernel();
+    calls += batch;
+    batch *= 2;
+    elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+  return {calls, elapsed / static_cast<double>(calls)};
+}
+
+/*
+  One JSON record per kernel and problem size; `bytes` is the memory traffic per call
+  and is omitted from the record if zero.
+ */
+inline nlohmann::ordered_json make_record(const std::string &kernel, std::size_t n,
+                                          std::size_t levels, const measurement &m,
+                                          std::size_t bytes = 0) {
+  nlohmann::ordered_json record;
+  record["kernel"]       = kernel;
+  record["N"]            = n;
+  record["levels"]       = levels;
+  record["calls"]        = m.calls;
+  record["ns_per_call"]  = 1e9 * m.seconds_per_call;
+  record["ns_per_site"]  = 1e9 * m.seconds_per_call / static_cast<double>(n);
+  record["calls_per_s"] = 1. / m.seconds_per_call;
+  if (bytes > 0)
+    record["GB_per_s"] = 1e-9 * static_cast<double>(bytes) / m.seconds_per_call;
+  return record;
+}
+
+} // namespace benchmark
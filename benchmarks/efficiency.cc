@@ -0,0 +1,311 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/common/mcmc_result.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/distributions/gaussian_even_odd_conditional.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/gaussian_direct_sampler.hh"
+#include "mlmcpi/samplers/hmc.hh"
+#include "mlmcpi/samplers/multilevel_sampler.hh"
+#include "mlmcpi/samplers/random_walk_sampler.hh"
+#include "mlmcpi/samplers/sampler.hh"
+#include "mlmcpi/samplers/two_level_sampler.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::ordered_json;
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#ifndef MLMCPI_GIT_COMMIT
+#define MLMCPI_GIT_COMMIT "unknown"
+#endif
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+using Engine        = philox_engine;
+using Action        = harmonic_oscillator_action<Path>;
+using CoarseSampler = hmc_sampler<Action, Engine>;
+using DirectSampler = gaussian_direct_sampler<Action, Engine>;
+using OddEvenCond   = gaussian_even_odd_conditional<Action, Engine>;
+using QOI           = mean_displacement<Path>;
+
+namespace {
+
+/*
+  Runs `sampler` for `budget` seconds of wall-clock time after the burn-in (during which
+  adaptive samplers are tuned) and summarises its statistical efficiency:
+  - ESS = n / tau, and ESS/s
+  - the time needed to reach `target_error`, extrapolated with error^2 ~ 1 / time
+  - the bias against the exact value, in units of the statistical error
+ */
+template <typename Sampler>
+json run_config(const std::string &name, Sampler &sampler, const Path &initial_path,
+                std::size_t n_burnin, double budget, double target_error, double exact) {
+  using clock = std::chrono::steady_clock;
+  std::cerr << "Running " << name << std::endl;
+
+  if constexpr (adaptive_sampler<Sampler>)
+    sampler.start_adaptation(n_burnin);
+
+  auto current   = sampler.make_state(initial_path);
+  auto workspace = current;
+  run_steps(sampler, current, workspace, n_burnin);
+
+  if constexpr (adaptive_sampler<Sampler>)
+    sampler.stop_adaptation();
+
+  QOI qoi;
+  mcmc_result<double> result;
+
+  // Check the clock every 100 steps only
+  double elapsed   = 0;
+  const auto start = clock::now();
+  while (elapsed < budget) {
+    for (std::size_t i = 0; i < 100; ++i) {
+      const bool accepted = sampler.step(current, workspace);
+      result.add_sample(qoi(current.path), accepted);
+    }
+    elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  }
+
+  const auto n     = static_cast<double>(result.num_samples());
+  const auto tau   = result.integrated_autocorr_time();
+  const auto error = result.mean_error();
+  const auto ess   = n / tau.tau;
+  const auto ratio = error / target_error;
+
+  json record;
+  record["config"]          = name;
+  record["seconds"]         = elapsed;
+  record["steps"]           = result.num_samples();
+  record["steps_per_s"]     = n / elapsed;
+  record["acceptance_rate"] = result.acceptance_rate();
+  record["mean"]            = result.mean();
+  record["error"]           = error;
+  record["tau"]             = tau.tau;
+  record["tau_error"]       = tau.error;
+  record["ess"]             = ess;
+  record["ess_per_s"]       = ess / elapsed;
+  record["time_to_target"]  = elapsed * ratio * ratio;
+  record["bias"]            = result.mean() - exact;
+  record["bias_sigma"]      = std::abs(result.mean() - exact) / error;
+  return record;
+}
+
+/*
+  Compares a record with the record of the same configuration in the baseline and
+  returns the list of regressions:
+  - throughput: steps/s dropped by more than the relative `tolerance`
+  - efficiency: tau grew by more than `tolerance`, beyond its statistical error
+  - ess_per_s: ESS/s dropped by more than `tolerance`, beyond its statistical error
+  - bias: the estimate is more than `max_bias_sigma` errors away from the exact value
+  - unconverged: fewer than `min_ess` effective samples, so neither the error nor the
+    bias can be trusted; the bias is not checked then
+  The last two checks do not need a baseline.
+ */
+json find_regressions(const json &record, const json *baseline, double tolerance,
+                      double max_bias_sigma, double min_ess) {
+  json flags = json::array();
+
+  if (record["ess"].get<double>() < min_ess)
+    flags.push_back("unconverged");
+  else if (record["bias_sigma"].get<double>() > max_bias_sigma)
+    flags.push_back("bias");
+
+  if (baseline == nullptr)
+    return flags;
+
+  if (record["steps_per_s"].get<double>() <
+      (1 - tolerance) * (*baseline)["steps_per_s"].get<double>())
+    flags.push_back("throughput");
+
+  // tau and ESS/s have the relative error of tau; only count significant changes
+  const auto tau       = record["tau"].get<double>();
+  const auto tau_base  = (*baseline)["tau"].get<double>();
+  const auto rel_error = std::hypot(record["tau_error"].get<double>() / tau,
+                                    (*baseline)["tau_error"].get<double>() / tau_base);
+  if (tau > (1 + tolerance) * tau_base && tau / tau_base - 1 > 2 * rel_error)
+    flags.push_back("efficiency");
+
+  const auto ess_per_s      = record["ess_per_s"].get<double>();
+  const auto ess_per_s_base = (*baseline)["ess_per_s"].get<double>();
+  if (ess_per_s < (1 - tolerance) * ess_per_s_base &&
+      1 - ess_per_s / ess_per_s_base > 2 * rel_error)
+    flags.push_back("ess_per_s");
+
+  return flags;
+}
+
+const json *find_config(const json &results, const std::string &name) {
+  for (const auto &record : results)
+    if (record["config"] == name)
+      return &record;
+  return nullptr;
+}
+
+} // namespace
+
+/*
+  Usage: efficiency <parameter file> [baseline file] [output file]
+
+  Runs HMC, random walk, the exact direct sampler and two-level and multilevel
+  (L = 3, ..., max_levels) samplers for the harmonic oscillator, the latter with HMC or
+  the direct sampler on the coarsest level. Each configuration runs for a fixed
+  wall-clock budget. Writes their efficiency as JSON (to the output file or stdout). If a
+  baseline (a previous output) is given, configurations that regress beyond `tolerance`
+  are flagged and the program exits with a non-zero status.
+ */
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  std::ifstream params_file(argv[1]);
+  const auto params = nlohmann::json::parse(params_file);
+
+  const double T               = params["T"];
+  const std::size_t N          = params["N"];
+  const double m0              = params["m0"];
+  const double mu2             = params["mu2"];
+  const std::size_t n_burnin   = params["n_burnin"];
+  const double budget          = params["budget_seconds"];
+  const double target_error    = params["stat_error"];
+  const double hmc_acc_rate    = params["hmc_acc_rate"];
+  const double rw_variance     = params["rw_variance"];
+  const std::size_t rw_burnin  = params["rw_burnin"];
+  const std::size_t max_levels = params["max_levels"];
+  const double tolerance       = params["tolerance"];
+  const double max_bias_sigma  = params["max_bias_sigma"];
+  const double min_ess         = params["min_ess"];
+  const std::uint64_t seed     = params["seed"];
+
+  json baseline;
+  if (argc > 2) {
+    std::ifstream baseline_file(argv[2]);
+    baseline = json::parse(baseline_file);
+  }
+
+  const double delta_t    = T / static_cast<double>(N);
+  const double exact      = analytic_solution(delta_t, m0, mu2, N);
+  const Path initial_path = ZeroPath(N);
+
+  Engine engine{seed};
+  json results = json::array();
+
+  const auto run = [&](const std::string &name, auto &sampler,
+                       std::size_t burnin_steps) {
+    results.push_back(run_config(name, sampler, initial_path, burnin_steps, budget,
+                                 target_error, exact));
+  };
+
+  {
+    Action action{N, delta_t, m0, mu2};
+    hmc_sampler<Action, Engine> sampler{delta_t, action, engine};
+    sampler.set_target_acceptance_rate(hmc_acc_rate);
+    run("hmc", sampler, n_burnin);
+  }
+
+  {
+    Action action{N, delta_t, m0, mu2};
+    random_walk_sampler<Action, diagonal_covariance<Path>, Engine> sampler{
+        diagonal_covariance<Path>(N, rw_variance), action, engine};
+    // Random walk steps are cheap but mix slowly, so it gets a longer burn-in
+    run("random_walk", sampler, rw_burnin);
+  }
+
+  {
+    Action action{N, delta_t, m0, mu2};
+    DirectSampler sampler{action, engine};
+    run("direct", sampler, n_burnin);
+  }
+
+  /*
+    Two-level and multilevel samplers (L = 3, ..., max_levels, as long as the coarsest
+    level keeps at least four sites), with the coarsest level sampled by the sampler
+    returned from make_coarse_sampler(coarsest_action).
+   */
+  const auto run_hierarchies = [&](const std::string &suffix, auto make_coarse_sampler) {
+    {
+      Action action{N, delta_t, m0, mu2};
+      auto coarse_action  = action.make_coarsened_action();
+      auto coarse_sampler = make_coarse_sampler(coarse_action);
+      OddEvenCond conditional{action, engine};
+      two_level_sampler sampler{action, coarse_sampler, conditional, engine};
+      run("two_level" + suffix, sampler, n_burnin);
+    }
+
+    for (std::size_t levels = 3; levels <= max_levels && (N >> (levels - 1)) >= 4;
+         ++levels) {
+      const auto coarsening = static_cast<double>(std::size_t{1} << (levels - 1));
+      Action coarsest_action{N >> (levels - 1), coarsening * delta_t, m0, mu2};
+      auto coarse_sampler = make_coarse_sampler(coarsest_action);
+
+      auto factory = [&](const Action &action) { return OddEvenCond{action, engine}; };
+      multilevel_sampler<Action, decltype(coarse_sampler), decltype(factory), Engine>
+          sampler{levels, coarsest_action, coarse_sampler, factory, engine};
+      run("multilevel_L" + std::to_string(levels) + suffix, sampler, n_burnin);
+    }
+  };
+
+  run_hierarchies("", [&](Action &coarse_action) {
+    CoarseSampler coarse_sampler{coarse_action.get_delta_t(), coarse_action, engine};
+    coarse_sampler.set_target_acceptance_rate(hmc_acc_rate);
+    return coarse_sampler;
+  });
+
+  run_hierarchies("_direct", [&](Action &coarse_action) {
+    return DirectSampler{coarse_action, engine};
+  });
+
+  bool regressed = false;
+  std::cerr << std::left << std::setw(22) << "config" << std::setw(12) << "steps/s"
+            << std::setw(10) << "tau" << std::setw(12) << "ESS/s" << std::setw(10)
+            << "bias/err"
+            << "flags\n";
+  for (auto &record : results) {
+    const json *base = baseline.is_null()
+                           ? nullptr
+                           : find_config(baseline["results"], record["config"]);
+    record["flags"] = find_regressions(record, base, tolerance, max_bias_sigma, min_ess);
+    regressed       = regressed || not record["flags"].empty();
+
+    std::cerr << std::setw(22) << record["config"].get<std::string>() << std::setw(12)
+              << record["steps_per_s"].get<double>() << std::setw(10)
+              << record["tau"].get<double>() << std::setw(12)
+              << record["ess_per_s"].get<double>() << std::setw(10)
+              << record["bias_sigma"].get<double>() << record["flags"].dump() << "\n";
+  }
+
+  json output;
+  output["commit"]    = MLMCPI_GIT_COMMIT;
+  output["compiler"]  = __VERSION__;
+  output["timestamp"] = std::time(nullptr);
+  output["exact"]     = exact;
+  output["params"]    = params;
+  output["results"]   = std::move(results);
+
+  if (argc > 3) {
+    std::ofstream file(argv[3]);
+    file << output.dump(2) << std::endl;
+  } else {
+    std::cout << output.dump(2) << std::endl;
+  }
+
+  return regressed ? 1 : 0;
+}
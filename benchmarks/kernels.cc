@@ -0,0 +1,214 @@
+#include "benchmark.hh"
+#include "mlmcpi/actions/anharmonic_oscillator.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/common/partition.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/distributions/gaussian_even_odd_conditional.hh"
+#include "mlmcpi/samplers/hmc.hh"
+#include "mlmcpi/samplers/multilevel_sampler.hh"
+#include "mlmcpi/samplers/two_level_sampler.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::ordered_json;
+
+#include <cstddef>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+
+#ifndef MLMCPI_GIT_COMMIT
+#define MLMCPI_GIT_COMMIT "unknown"
+#endif
+
+using namespace mlmcpi;
+using benchmark::make_record;
+using benchmark::measure;
+
+#if USE_BLAZE
+using Path = blaze::DynamicVector<double>;
+#endif
+
+using Engine      = philox_engine;
+using Action      = harmonic_oscillator_action<Path>;
+using OddEvenCond = gaussian_even_odd_conditional<Action, Engine>;
+
+namespace {
+
+constexpr double T      = 4.;
+constexpr double m0     = 1.;
+constexpr double mu2    = 1.;
+constexpr auto n_double = sizeof(double);
+
+// Number of leapfrog steps of the coarsest HMC sampler in the sampler benchmarks
+constexpr std::size_t coarse_hmc_steps = 10;
+
+// Steps before timing the samplers, so that the acceptance rate is roughly stationary
+constexpr std::size_t sampler_warmup_steps = 10;
+
+Path random_path(std::size_t n, Engine &engine) {
+  Path path(n);
+  fill_normal(engine, std::span<double>{path.data(), path.size()});
+  return path;
+}
+
+// Kernels of the action, the odd-even conditional and the partitioning on N sites
+void benchmark_kernels(std::size_t N, Engine &engine, json &records) {
+  const Action action{N, T / static_cast<double>(N), m0, mu2};
+  const Action coarse_action = action.make_coarsened_action();
+  const auto path            = random_path(N, engine);
+
+  records.push_back(make_record("action_evaluate", N, 1, measure([&]() {
+                                  benchmark::do_not_optimize(action.evaluate(path));
+                                }),
+                                N * n_double));
+
+  Path force(N);
+  records.push_back(make_record("action_grad_potential", N, 1, measure([&]() {
+                                  action.grad_potential_into(path, force);
+                                  benchmark::do_not_optimize(force[0]);
+                                }),
+                                2 * N * n_double));
+
+  records.push_back(make_record("partition_odd_even", N, 1, measure([&]() {
+                                  auto [odd, even] = partition_odd_even(path);
+                                  benchmark::do_not_optimize(odd[0] + even[0]);
+                                }),
+                                2 * N * n_double));
+
+  Path work = path;
+  const std::span<double> work_span{work.data(), work.size()};
+  records.push_back(make_record("fill_normal", N, 1, measure([&]() {
+                                  fill_normal(engine, work_span);
+                                  benchmark::do_not_optimize(work[0]);
+                                }),
+                                N * n_double));
+
+  // The conditional acts on the fine path; the even sites are the coarse path
+  OddEvenCond conditional{action, engine};
+  const auto coarse_path = random_path(coarse_action.get_path_length(), engine);
+  records.push_back(make_record("conditional_sample", N, 1, measure([&]() {
+                                  auto odd = conditional.sample(coarse_path);
+                                  benchmark::do_not_optimize(odd[0]);
+                                }),
+                                N * n_double));
+
+  records.push_back(make_record("conditional_sample_odd_sites", N, 1, measure([&]() {
+                                  conditional.sample_odd_sites(work);
+                                  benchmark::do_not_optimize(work[0]);
+                                }),
+                                N * n_double));
+
+  records.push_back(make_record("conditional_log_density", N, 1, measure([&]() {
+                                  benchmark::do_not_optimize(
+                                      conditional.log_density(path));
+                                }),
+                                N * n_double));
+
+  // The quartic action, with V' (and V'' for the conditional) from dual numbers
+  using QuarticAction = anharmonic_oscillator_action<Path, quartic_potential>;
+  const QuarticAction quartic_action{N, T / static_cast<double>(N), m0, {mu2, 1.}};
+  records.push_back(make_record("quartic_action_evaluate", N, 1, measure([&]() {
+                                  benchmark::do_not_optimize(
+                                      quartic_action.evaluate(path));
+                                }),
+                                N * n_double));
+
+  records.push_back(make_record("quartic_action_grad_potential", N, 1, measure([&]() {
+                                  quartic_action.grad_potential_into(path, force);
+                                  benchmark::do_not_optimize(force[0]);
+                                }),
+                                2 * N * n_double));
+
+  gaussian_even_odd_conditional<QuarticAction, Engine> quartic_conditional{
+      quartic_action, engine};
+  records.push_back(make_record("quartic_conditional_sample_odd_sites", N, 1,
+                                measure([&]() {
+                                  quartic_conditional.sample_odd_sites(work);
+                                  benchmark::do_not_optimize(work[0]);
+                                }),
+                                N * n_double));
+}
+
+/*
+  Full steps of the two-level sampler (levels = 2) and of the multilevel sampler with the
+  given number of levels; the finest level has N sites and the coarsest level is
+  sampled with HMC. The samplers start from the zero path.
+ */
+void benchmark_sampler_step(std::size_t N, std::size_t levels, Engine &engine,
+                            json &records) {
+  const auto coarsest_N = N >> (levels - 1);
+  const auto delta_t    = T / static_cast<double>(N);
+  Action coarsest_action{coarsest_N, delta_t * static_cast<double>(N / coarsest_N), m0,
+                         mu2};
+  hmc_sampler<Action, Engine> coarse_sampler{coarsest_action.get_delta_t(),
+                                             coarsest_action, engine, coarse_hmc_steps};
+
+  const Path initial_path(N, 0.);
+
+  const auto measure_steps = [&](auto &sampler, const std::string &name) {
+    auto state     = sampler.make_state(initial_path);
+    auto workspace = state;
+    run_steps(sampler, state, workspace, sampler_warmup_steps);
+    const auto kernel = [&]() { sampler.step(state, workspace); };
+    records.push_back(make_record(name, N, levels, measure(kernel)));
+  };
+
+  if (levels == 2) {
+    Action action = coarsest_action.make_finer_action();
+    OddEvenCond conditional{action, engine};
+    two_level_sampler sampler{action, coarse_sampler, conditional, engine};
+    measure_steps(sampler, "two_level_step");
+    return;
+  }
+
+  auto factory = [&](const Action &action) { return OddEvenCond{action, engine}; };
+  multilevel_sampler<Action, decltype(coarse_sampler), decltype(factory), Engine> sampler{
+      levels, coarsest_action, coarse_sampler, factory, engine};
+  measure_steps(sampler, "multilevel_step");
+}
+
+} // namespace
+
+/*
+  Usage: kernels [min log2 N] [max log2 N] [max levels] [output file]
+
+  Sweeps N = 2^min, ..., 2^max (default 2^6 ... 2^20) and, for the sampler steps, the
+  number of levels from 2 up to `max levels` (default 8), as long as the coarsest level
+  keeps at least 8 sites. Writes a JSON document with one record per kernel and size to
+  the output file, or to stdout if none is given.
+ */
+int main(int argc, char *argv[]) {
+  const std::size_t min_log2_N = argc > 1 ? std::stoul(argv[1]) : 6;
+  const std::size_t max_log2_N = argc > 2 ? std::stoul(argv[2]) : 20;
+  const std::size_t max_levels = argc > 3 ? std::stoul(argv[3]) : 8;
+
+  Engine engine{42};
+  json records = json::array();
+
+  for (auto log2_N = min_log2_N; log2_N <= max_log2_N; ++log2_N) {
+    const std::size_t N = std::size_t{1} << log2_N;
+    std::cerr << "N = " << N << std::endl;
+
+    benchmark_kernels(N, engine, records);
+    for (std::size_t levels = 2; levels <= max_levels; ++levels)
+      if ((N >> (levels - 1)) >= 8)
+        benchmark_sampler_step(N, levels, engine, records);
+  }
+
+  json output;
+  output["commit"]    = MLMCPI_GIT_COMMIT;
+  output["compiler"]  = __VERSION__;
+  output["timestamp"] = std::time(nullptr);
+  output["results"]   = std::move(records);
+
+  if (argc > 4) {
+    std::ofstream file(argv[4]);
+    file << output.dump(2) << std::endl;
+  } else {
+    std::cout << output.dump(2) << std::endl;
+  }
+}
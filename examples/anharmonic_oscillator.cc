@@ -0,0 +1,84 @@
+#include "mlmcpi/actions/anharmonic_oscillator.hh"
+#include "mlmcpi/distributions/gaussian_even_odd_conditional.hh"
+#include "mlmcpi/monte_carlo/single_level_mcmc.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/hmc.hh"
+#include "mlmcpi/samplers/two_level_sampler.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+/*
+  Estimates <x^2> for the anharmonic potential V(x) = mu2 / 2 x^2 + lambda / 4 x^4 (with
+  `lambda` from the parameters, 1 by default) with HMC and with the two-level sampler,
+  whose even-odd conditional is the Gaussian approximation derived from V. Both estimates
+  have to agree within their errors.
+ */
+template <typename Sampler>
+void run(const std::string &name, Sampler &sampler, const json &params, std::size_t N) {
+  single_level_mcmc mcmc{sampler};
+  const auto result = mcmc.template run<mean_displacement<Path>>(
+      params["n_burnin"], ZeroPath(N), params["stat_error"]);
+
+  std::cout << name << ": <x^2> = " << result.mean() << " ± " << result.mean_error()
+            << ", " << result.num_samples() << " samples, acceptance rate "
+            << result.acceptance_rate() << ", autocorr. time "
+            << result.integrated_autocorr_time().tau << "\n";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  using Engine = std::mt19937_64;
+
+  std::random_device rd;
+  Engine engine{rd()};
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  using Action = anharmonic_oscillator_action<Path, quartic_potential>;
+  const quartic_potential potential{params["mu2"], params.value("lambda", 1.)};
+  Action action{N, delta_t, params["m0"], potential};
+
+  {
+    hmc_sampler<Action, Engine> sampler{delta_t, action, engine};
+    sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
+    run("HMC", sampler, params, N);
+  }
+
+  {
+    auto coarse_action = action.make_coarsened_action();
+    hmc_sampler<Action, Engine> coarse_sampler{coarse_action.get_delta_t(), coarse_action,
+                                               engine};
+    coarse_sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
+    gaussian_even_odd_conditional<Action, Engine> conditional{action, engine};
+    two_level_sampler sampler{action, coarse_sampler, conditional, engine};
+    run("Two-level", sampler, params, N);
+
+    const auto &fine = sampler.get_level_statistics()[1];
+    std::cout << "Fine level acceptance rate = " << fine.acceptance_rate()
+              << ", delta_S = " << fine.delta_S.mean() << " ± "
+              << std::sqrt(fine.delta_S.variance()) << "\n";
+  }
+}
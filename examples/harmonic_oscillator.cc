@@ -16,6 +16,7 @@ using json = nlohmann::json;
 #include <iostream>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <random>
 
 using namespace mlmcpi;
@@ -34,7 +35,8 @@ int main(int argc, char *argv[]) {
   using Engine = std::mt19937_64;
 
   std::random_device rd;
-  Engine engine{rd()};
+  const auto seed = rd();
+  Engine engine{seed};
 
   std::ifstream params_file(argv[1]);
   json params = json::parse(params_file);
@@ -49,21 +51,45 @@ int main(int argc, char *argv[]) {
   Action action{N, delta_t, params["m0"], params["mu2"]};
 
   hmc_sampler<Action, Engine> single_step_sampler{delta_t, action, engine};
+  single_step_sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
   const auto initial_path = ZeroPath(N);
-  const auto tuned_value =
-      single_step_sampler.autotune_stepsize(initial_path, params["hmc_acc_rate"]);
-
-  if (tuned_value)
-    std::cout << "Tuned hmc sampler with step size " << tuned_value.value() << "\n";
-  else
-    std::cout << "Failed to tune hmc sampler\n";
 
+  // The step size is tuned during the burn-in
   using QOI = mean_displacement<Action::PathType>;
   single_level_mcmc sampler{single_step_sampler};
 
+  // A killed run continues from its last checkpoint when restarted
+  if (params.contains("checkpoint_file")) {
+    sampler.enable_checkpoints(params["checkpoint_file"], params["checkpoint_interval"],
+                               engine);
+    sampler.set_checkpoint_parameters(action);
+  }
+
+  // Streams the QOI of every sample and every `trace_path_thinning`-th path to disk. With
+  // checkpoints, a restarted run continues the trace of the killed one, seed included.
+  std::optional<trace_writer> trace;
+  if (params.contains("trace_file")) {
+    trace_header header{.path_length   = N,
+                        .levels        = 1,
+                        .delta_t       = delta_t,
+                        .seed          = seed,
+                        .qoi_size      = 1,
+                        .path_thinning = params.value("trace_path_thinning", 0u)};
+    const auto mode =
+        params.contains("checkpoint_file") ? trace_mode::resume : trace_mode::create;
+    trace.emplace(params["trace_file"], header, mode);
+    sampler.enable_trace(*trace);
+  }
+
   const auto result =
       sampler.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
 
+  if (trace && not trace->close())
+    std::cerr << "Could not write trace " << params["trace_file"] << "\n";
+
+  std::cout << "Tuned hmc sampler with step size " << single_step_sampler.get_stepsize()
+            << "\n";
+
   const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
 
   std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
@@ -71,5 +97,6 @@ int main(int argc, char *argv[]) {
   std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
   std::cout << "Samples         = " << result.num_samples() << "\n";
   std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n";
-  std::cout << "Autocorr. time  = " << result.integrated_autocorr_time() << "\n";
+  const auto tau = result.integrated_autocorr_time();
+  std::cout << "Autocorr. time  = " << tau.tau << " ± " << tau.error << "\n";
 }
@@ -0,0 +1,98 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/common/multi_chain_result.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/samplers/batch_hmc.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  const std::size_t n_chains = params["n_chains"];
+  const std::size_t n_burnin = params["n_burnin"];
+  const double target_error  = params["stat_error"];
+  const std::uint64_t seed   = params["seed"];
+
+  using Engine = philox_engine;
+  using Action = harmonic_oscillator_action<Path>;
+
+  Engine engine{seed};
+  Action action{N, delta_t, params["m0"], params["mu2"]};
+
+  // All chains advance in lock-step on a single core
+  batch_hmc_sampler<Action, Engine> sampler{delta_t, action, engine};
+  sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
+
+  const Path initial_path = ZeroPath(N);
+  auto state              = sampler.make_state(initial_path, n_chains);
+
+  sampler.start_adaptation(n_burnin);
+  for (std::size_t i = 0; i < n_burnin; ++i)
+    sampler.perform_step(state);
+  sampler.stop_adaptation();
+
+  // The QOI (mean displacement) of all chains, computed site by site
+  std::vector<double> qoi(n_chains);
+  const auto compute_qoi = [&]() {
+    std::fill(qoi.begin(), qoi.end(), 0.);
+    for (std::size_t i = 0; i < N; ++i) {
+      const double *x = state.paths.site(i);
+      for (std::size_t k = 0; k < n_chains; ++k)
+        qoi[k] += x[k] * x[k] / static_cast<double>(N);
+    }
+  };
+
+  multi_chain_result<double> result(n_chains);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::size_t steps = 0;
+  do {
+    for (std::size_t i = 0; i < 100; ++i, ++steps) {
+      sampler.perform_step(state);
+      compute_qoi();
+      for (std::size_t k = 0; k < n_chains; ++k)
+        result.chains[k].add_sample(qoi[k], sampler.was_accepted(k));
+    }
+  } while (result.mean_error() > target_error || result.mean_error() < 1e-12);
+  const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+  const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+
+  std::cout << "Tuned hmc sampler with step size " << sampler.get_stepsize() << "\n";
+  std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
+            << "\n";
+  std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
+  std::cout << "Samples         = " << result.num_samples() << "\n";
+  std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n";
+  std::cout << "R-hat           = " << result.r_hat() << "\n";
+  std::cout << "Chain steps/s   = "
+            << static_cast<double>(steps * n_chains) / duration.count() << "\n";
+}
@@ -0,0 +1,82 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/monte_carlo/single_level_mcmc.hh"
+#include "mlmcpi/qoi/control_variate.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/hmc.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+// Site average of x^4
+struct mean_quartic {
+  using ResultType = double;
+
+  double operator()(const Path &path) const {
+    double sum = 0;
+    for (std::size_t i = 0; i < path.size(); ++i)
+      sum += path[i] * path[i] * path[i] * path[i];
+    return sum / static_cast<double>(path.size());
+  }
+};
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  using Engine = std::mt19937_64;
+
+  std::random_device rd;
+  Engine engine{rd()};
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  using Action = harmonic_oscillator_action<Path>;
+  Action action{N, delta_t, params["m0"], params["mu2"]};
+
+  hmc_sampler<Action, Engine> single_step_sampler{delta_t, action, engine};
+  single_step_sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
+  const auto initial_path = ZeroPath(N);
+
+  // <x^4> is estimated with <x^2> as control variate, whose expectation is known exactly;
+  // the run stops once the reduced error reaches the target
+  using QOI = control_variate<mean_quartic, mean_displacement<Path>>;
+  single_level_mcmc sampler{single_step_sampler};
+
+  const auto result =
+      sampler.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
+
+  const auto x2    = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+  const auto exact = 3 * x2 * x2;
+
+  std::cout << "Samples            = " << result.num_samples() << "\n";
+  std::cout << "Acceptance rate    = " << result.acceptance_rate() << "\n";
+  std::cout << "<x^4>              = " << result.mean(x2) << " ± " << result.mean_error()
+            << "\n";
+  std::cout << "<x^4> (plain)      = " << result.plain_mean() << " ± "
+            << result.plain_mean_error() << "\n";
+  std::cout << "Exact              = " << exact << "\n";
+  std::cout << "Coefficient        = " << result.coefficient() << "\n";
+  std::cout << "Correlation        = " << result.correlation() << "\n";
+  std::cout << "Variance reduction = " << result.variance_reduction() << "\n";
+}
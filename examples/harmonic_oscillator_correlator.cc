@@ -0,0 +1,98 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/common/circulant.hh"
+#include "mlmcpi/monte_carlo/single_level_mcmc.hh"
+#include "mlmcpi/qoi/path_moments.hh"
+#include "mlmcpi/qoi/qoi_set.hh"
+#include "mlmcpi/qoi/two_point_correlator.hh"
+#include "mlmcpi/samplers/hmc.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  using Engine = std::mt19937_64;
+
+  std::random_device rd;
+  Engine engine{rd()};
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  using Action = harmonic_oscillator_action<Path>;
+  Action action{N, delta_t, params["m0"], params["mu2"]};
+
+  hmc_sampler<Action, Engine> single_step_sampler{delta_t, action, engine};
+  single_step_sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
+  const auto initial_path = ZeroPath(N);
+
+  // The moments <x>, ..., <x^4> and the correlator C(tau) are measured together; the run
+  // continues until all of them reach the target error. Since the correlator costs two
+  // FFTs, the measurements are thinned to about a quarter of the autocorrelation time.
+  using QOI = qoi_set<Path, path_moments<Path, 4>, two_point_correlator<Path>>;
+  single_level_mcmc sampler{single_step_sampler};
+  sampler.adapt_measurement_interval = true;
+
+  const auto result =
+      sampler.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
+
+  // For the Gaussian action 0.5 x^T C x, <x_0 x_tau> = (C^{-1})_{0,tau}
+  circulant_operator op{action.circulant_kernel()};
+  Path unit(N, 0.);
+  unit[0] = 1.;
+  Path exact_correlator(N);
+  op.apply_spectral(unit, exact_correlator, op.spectrum_power(-1.));
+
+  const auto x2 = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+  const std::vector<double> exact_moments{0., x2, 0., 3 * x2 * x2};
+
+  std::cout << "Steps           = " << result.num_steps() << "\n";
+  std::cout << "Measurements    = " << result.num_samples() << "\n";
+  std::cout << "Interval        = " << sampler.measurement_interval << "\n";
+  std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n\n";
+
+  std::cout << "Moment  Result                  Exact\n";
+  const auto moments = QOI::offset<0>(N);
+  for (std::size_t k = 0; k < exact_moments.size(); ++k)
+    std::cout << "<x^" << k + 1 << ">   " << std::setw(10) << result.mean(moments + k)
+              << " ± " << std::setw(10) << result.mean_error(moments + k) << "  "
+              << exact_moments[k] << "\n";
+
+  // Autocorrelation times in steps of the chain
+  std::cout << "\ntau     C(tau)                  Exact       Autocorr. time\n";
+  const auto correlator = QOI::offset<1>(N);
+  const auto step       = std::max<std::size_t>(1, N / 16);
+  for (std::size_t tau = 0; tau <= N / 2; tau += step) {
+    const auto i = correlator + tau;
+    std::cout << std::setw(8) << std::left << tau * delta_t << std::right << std::setw(10)
+              << result.mean(i) << " ± " << std::setw(10) << result.mean_error(i) << "  "
+              << std::setw(10) << exact_correlator[tau] << "  "
+              << result.integrated_autocorr_time(i).tau * result.steps_per_sample()
+              << "\n";
+  }
+}
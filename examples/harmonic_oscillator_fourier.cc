@@ -0,0 +1,85 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/monte_carlo/single_level_mcmc.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/hmc.hh"
+#include "mlmcpi/samplers/mass_matrices.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <random>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  using Engine = std::mt19937_64;
+
+  std::random_device rd;
+  Engine engine{rd()};
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  using Action = harmonic_oscillator_action<Path>;
+  Action action{N, delta_t, params["m0"], params["mu2"]};
+
+  // With the Hessian of the action as mass matrix, every Fourier mode oscillates with
+  // unit frequency, so a trajectory of length pi/2 produces (almost) independent samples.
+  const std::size_t n_steps = 10;
+  fourier_hmc_sampler<Action, Engine> single_step_sampler{
+      std::numbers::pi / (2 * n_steps), action, engine, n_steps, hmc_integrator::leapfrog,
+      circulant_mass<Path>(action.circulant_kernel())};
+
+  const auto initial_path = ZeroPath(N);
+  const auto tuned_value =
+      single_step_sampler.autotune_stepsize(initial_path, params["hmc_acc_rate"]);
+
+  if (tuned_value) {
+    // Keep the trajectory length at pi/2 with a step size no larger than the tuned one
+    const auto steps = std::ceil(0.5 * std::numbers::pi / tuned_value.value());
+    single_step_sampler.set_trajectory_steps(static_cast<std::size_t>(steps));
+    single_step_sampler.set_stepsize(0.5 * std::numbers::pi / steps);
+    std::cout << "Tuned hmc sampler with step size " << single_step_sampler.get_stepsize()
+              << "\n";
+  } else {
+    std::cout << "Failed to tune hmc sampler\n";
+  }
+
+  // Keep the step size (and hence the trajectory length) fixed during the burn-in
+  using QOI = mean_displacement<Action::PathType>;
+  single_level_mcmc sampler{single_step_sampler};
+  sampler.adapt_during_burnin = false;
+
+  const auto result =
+      sampler.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
+
+  const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+
+  std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
+            << "\n";
+  std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
+  std::cout << "Samples         = " << result.num_samples() << "\n";
+  std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n";
+  const auto tau = result.integrated_autocorr_time();
+  std::cout << "Autocorr. time  = " << tau.tau << " ± " << tau.error << "\n";
+}
@@ -0,0 +1,96 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/distributions/gaussian_even_odd_conditional.hh"
+#include "mlmcpi/monte_carlo/multilevel_mcmc.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/coupled_level_sampler.hh"
+#include "mlmcpi/samplers/hmc.hh"
+#include "mlmcpi/samplers/two_level_sampler.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  using Engine = std::mt19937_64;
+
+  std::random_device rd;
+  Engine engine{rd()};
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  using Action      = harmonic_oscillator_action<Path>;
+  using HMC         = hmc_sampler<Action, Engine>;
+  using OddEvenCond = gaussian_even_odd_conditional<Action, Engine>;
+  using TwoLevel    = two_level_sampler<Action, HMC, OddEvenCond, Engine>;
+
+  // Three levels with N / 4, N / 2 and N time steps
+  Action action_2{N, delta_t, params["m0"], params["mu2"]};
+  auto action_1 = action_2.make_coarsened_action();
+  auto action_0 = action_1.make_coarsened_action();
+
+  OddEvenCond conditional_1{action_1, engine};
+  OddEvenCond conditional_2{action_2, engine};
+
+  // Level 0 is sampled with HMC. The coarse chain of the first correction is an HMC chain
+  // on level 0, the one of the second correction a two-level chain on level 1. Every
+  // chain owns its coarse sampler, since each burn-in adapts the HMC step size.
+  HMC hmc_0{0.1, action_0, engine};
+  HMC coupled_hmc_0{0.1, action_0, engine};
+  HMC two_level_hmc_0{0.1, action_0, engine};
+  hmc_0.set_target_acceptance_rate(params["hmc_acc_rate"]);
+  coupled_hmc_0.set_target_acceptance_rate(params["hmc_acc_rate"]);
+  two_level_hmc_0.set_target_acceptance_rate(params["hmc_acc_rate"]);
+
+  TwoLevel two_level_1{action_1, two_level_hmc_0, conditional_1, engine};
+
+  const std::size_t coarse_steps = params["coarse_steps"];
+  coupled_level_sampler<Action, HMC, OddEvenCond, Engine> coupled_1{
+      action_1, coupled_hmc_0, conditional_1, engine, coarse_steps};
+  coupled_level_sampler<Action, TwoLevel, OddEvenCond, Engine> coupled_2{
+      action_2, two_level_1, conditional_2, engine, coarse_steps};
+
+  multilevel_mcmc mlmc{hmc_0, coupled_1, coupled_2};
+
+  using QOI               = mean_displacement<Path>;
+  const Path initial_path = ZeroPath(N);
+  const auto result =
+      mlmc.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
+
+  const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+
+  std::cout << "Level  Samples    Mean          Error         Acc. rate  Cost/sample\n";
+  for (std::size_t l = 0; l < result.num_levels(); ++l) {
+    const auto &level = result.levels[l];
+    std::cout << l << "      " << level.num_samples() << "      " << level.mean()
+              << "      " << level.mean_error() << "      " << level.acceptance_rate()
+              << "      " << result.cost_per_sample[l] << "\n";
+  }
+
+  std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
+            << "\n";
+  std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
+  std::cout << "Total cost      = " << result.total_cost() << " s\n";
+}
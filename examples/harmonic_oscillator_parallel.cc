@@ -0,0 +1,89 @@
+#include "analytic_solution.hh"
+#include "mlmcpi/actions/harmonic_oscillator.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/monte_carlo/parallel_mcmc.hh"
+#include "mlmcpi/qoi/mean_displacement.hh"
+#include "mlmcpi/samplers/hmc.hh"
+
+#include <blaze/Blaze.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace mlmcpi;
+
+#if USE_BLAZE
+using Path     = blaze::DynamicVector<double>;
+using ZeroPath = blaze::ZeroVector<double>;
+#endif
+
+using Engine = philox_engine;
+using Action = harmonic_oscillator_action<Path>;
+
+// Every chain owns its copy of the action; the sampler refers to it. The step size of
+// each chain is tuned during its burn-in.
+struct hmc_chain {
+  hmc_chain(const Action &action_, double acceptance_rate_target, Engine &engine)
+      : action{action_}, sampler{action.get_delta_t(), action, engine} {
+    sampler.set_target_acceptance_rate(acceptance_rate_target);
+  }
+
+  using PathType = Path;
+  using State    = hmc_sampler<Action, Engine>::State;
+
+  State make_state(const Path &path) { return sampler.make_state(path); }
+  bool step(State &current, State &workspace) { return sampler.step(current, workspace); }
+
+  void start_adaptation(std::size_t n) { sampler.start_adaptation(n); }
+  void stop_adaptation() { sampler.stop_adaptation(); }
+
+  Action action;
+  hmc_sampler<Action, Engine> sampler;
+};
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Provide parameter file as argument" << std::endl;
+    return -1;
+  }
+
+  std::ifstream params_file(argv[1]);
+  json params = json::parse(params_file);
+
+  const double T       = params["T"];
+  const std::size_t N  = params["N"];
+  const double delta_t = T / N;
+
+  const std::size_t n_chains = params["n_chains"];
+  const std::uint64_t seed   = params["seed"];
+
+  Action action{N, delta_t, params["m0"], params["mu2"]};
+  const auto initial_path = ZeroPath(N);
+
+  const double acceptance_rate_target = params["hmc_acc_rate"];
+  const auto make_chain = [&](std::size_t, Engine &engine) {
+    return hmc_chain{action, acceptance_rate_target, engine};
+  };
+
+  parallel_mcmc<decltype(make_chain), Engine> sampler{make_chain, n_chains, seed};
+  std::cout << "Running " << n_chains << " chains on " << sampler.get_num_threads()
+            << " threads\n";
+
+  using QOI = mean_displacement<Path>;
+  const auto result =
+      sampler.run<QOI>(params["n_burnin"], Path(initial_path), params["stat_error"]);
+
+  const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
+
+  std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
+            << "\n";
+  std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
+  std::cout << "Samples         = " << result.num_samples() << "\n";
+  std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n";
+  std::cout << "R-hat           = " << result.r_hat() << "\n";
+}
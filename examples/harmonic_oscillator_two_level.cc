@@ -52,25 +52,22 @@ int main(int argc, char *argv[]) {
   auto coarse_action = action.make_coarsened_action();
 
   CoarseSampler coarse_sampler{0.1, coarse_action, engine};
+  coarse_sampler.set_target_acceptance_rate(params["hmc_acc_rate"]);
   OddEvenCond even_odd_conditional{action, engine};
 
   Sampler sampler{action, coarse_sampler, even_odd_conditional, engine};
 
   single_level_mcmc mcmc(sampler);
 
-  Path initial_tune_path = ZeroPath(N / 2);
-  auto tuned_value =
-      coarse_sampler.autotune_stepsize(initial_tune_path, params["hmc_acc_rate"]);
-  if (tuned_value)
-    std::cout << "Tuned hmc sampler with step size " << tuned_value.value() << "\n";
-  else
-    std::cout << "Failed to tune hmc sampler\n";
-
+  // The step size of the coarse sampler is tuned during the burn-in
   Path initial_path = ZeroPath(N);
   using QOI         = mean_displacement<Path>;
   const auto result =
       mcmc.run<QOI>(params["n_burnin"], initial_path, params["stat_error"]);
 
+  std::cout << "Tuned hmc sampler with step size " << coarse_sampler.get_stepsize()
+            << "\n";
+
   const auto analytical = analytic_solution(delta_t, params["m0"], params["mu2"], N);
 
   std::cout << "Result          = " << result.mean() << " ± " << result.mean_error()
@@ -78,5 +75,20 @@ int main(int argc, char *argv[]) {
   std::cout << "|Q - Q_{exact}| = " << std::abs(result.mean() - analytical) << "\n";
   std::cout << "Samples         = " << result.num_samples() << "\n";
   std::cout << "Acceptance rate = " << result.acceptance_rate() << "\n";
-  std::cout << "Autocorr. time  = " << result.integrated_autocorr_time() << "\n";
+  const auto tau = result.integrated_autocorr_time();
+  std::cout << "Autocorr. time  = " << tau.tau << " ± " << tau.error << "\n";
+
+  // Where proposals are rejected: level 0 is the coarse HMC, level 1 the fine MH step
+  const auto &level_stats = sampler.get_level_statistics();
+  for (std::size_t level = 0; level < level_stats.size(); ++level) {
+    const auto &stats = level_stats[level];
+    std::cout << "Level " << level << ": " << stats.proposals << " proposals, "
+              << stats.accepted << " accepted, " << stats.rejected << " rejected";
+    if (stats.delta_S.count() > 0)
+      std::cout << ", delta_S = " << stats.delta_S.mean() << " ± "
+                << std::sqrt(stats.delta_S.variance());
+    if (stats.non_finite > 0)
+      std::cout << ", " << stats.non_finite << " non-finite";
+    std::cout << "\n";
+  }
 }
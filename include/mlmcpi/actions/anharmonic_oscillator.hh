@@ -0,0 +1,210 @@
+#pragma once
+
+#include "mlmcpi/common/dual.hh"
+#include "mlmcpi/common/path_ensemble.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Potentials V(x) for anharmonic_oscillator_action. They are templates in the argument
+  type, so the action can differentiate them with dual numbers (see dual.hh).
+ */
+
+// V(x) = mu2 / 2 x^2, the harmonic oscillator
+struct harmonic_potential {
+  double mu2 = 1.;
+
+  template <typename T> constexpr T operator()(const T &x) const {
+    return 0.5 * mu2 * x * x;
+  }
+};
+
+// V(x) = mu2 / 2 x^2 + lambda / 4 x^4; for mu2 < 0 the minima are at x^2 = -mu2 / lambda
+struct quartic_potential {
+  double mu2 = 1.;
+  double lambda = 1.;
+
+  template <typename T> constexpr T operator()(const T &x) const {
+    const T x2 = x * x;
+    return x2 * (0.5 * mu2 + 0.25 * lambda * x2);
+  }
+};
+
+// V(x) = lambda (x^2 - eta^2)^2, with minima at x = +-eta
+struct double_well_potential {
+  double lambda = 1.;
+  double eta = 1.;
+
+  template <typename T> constexpr T operator()(const T &x) const {
+    const T d = x * x - eta * eta;
+    return lambda * d * d;
+  }
+};
+
+/*
+  Lattice action of a particle of mass m0 in the potential V,
+    S(x) = sum_i delta_t [m0 / 2 ((x_i - x_{i-1}) / delta_t)^2 + V(x_i)]
+  with periodic boundary conditions. `Potential` is a functor as above; its derivatives
+  are derived at compile time with dual numbers, so evaluate and grad_potential consist
+  of branch-free loops with V and V' inlined, which the compiler vectorises.
+
+  For the even-odd conditional (see gaussian_even_odd_conditional.hh) the part of the
+  action that depends on an odd site x,
+    W(x) = m0 / (2 delta_t) ((x - x_m)^2 + (x_p - x)^2) + delta_t V(x),
+  is approximated by a Gaussian around its minimum, which is found with a few Newton
+  steps (exact for the harmonic potential). The conditional then is a proposal for
+  delayed acceptance rather than exact. Where W is not convex (e.g., between the wells of
+  a double well on a coarse lattice), the curvature is bounded below by half of that of
+  the kinetic term, so the proposal stays well-defined.
+ */
+template <typename TPathType, typename Potential> struct anharmonic_oscillator_action {
+  using PathType = TPathType;
+
+  static constexpr std::size_t n_newton_steps = 3;
+
+  anharmonic_oscillator_action(std::size_t path_length_, double delta_t_, double m0_,
+                               Potential potential_) noexcept
+      : path_length{path_length_},
+        delta_t{delta_t_},
+        m0{m0_},
+        potential{std::move(potential_)} {}
+
+  // `path` may also be a view of a path, see partition.hh
+  template <typename Vector> double evaluate(const Vector &path) const {
+    assert(path.size() == path_length);
+
+    // Site i contributes its potential and the kinetic term of the link (i - 1, i)
+    const auto n = path.size();
+    double res = site_action(path[0], path[n - 1]);
+
+    for (std::size_t i = 1; i < n; ++i)
+      res += site_action(path[i], path[i - 1]);
+
+    return res;
+  }
+
+  PathType grad_potential(const PathType &path) const {
+    PathType force(path.size());
+    grad_potential_into(path, force);
+    return force;
+  }
+
+  // Same as grad_potential but writes into the preallocated vector `force`
+  void grad_potential_into(const PathType &path, PathType &force) const {
+    assert(path.size() == path_length);
+    assert(force.size() == path.size());
+
+    const auto n = path.size();
+    const double *__restrict x = path.data();
+    double *__restrict f = force.data();
+
+    f[0] = site_force(x[0], x[n - 1], x[1]);
+
+    for (std::size_t i = 1; i < n - 1; ++i)
+      f[i] = site_force(x[i], x[i - 1], x[i + 1]);
+
+    f[n - 1] = site_force(x[n - 1], x[n - 2], x[0]);
+  }
+
+  // Batched versions of evaluate and grad_potential_into, see harmonic_oscillator.hh
+  void evaluate_batch(const path_ensemble<double> &paths,
+                      std::vector<double> &res) const {
+    assert(paths.get_path_length() == path_length);
+    const auto n_paths = paths.num_paths();
+    res.assign(n_paths, 0.);
+
+    double *__restrict r = res.data();
+    for (std::size_t i = 0; i < path_length; ++i) {
+      const double *__restrict x = paths.site(i);
+      const double *__restrict x_m = paths.site(i == 0 ? path_length - 1 : i - 1);
+
+      for (std::size_t k = 0; k < n_paths; ++k)
+        r[k] += site_action(x[k], x_m[k]);
+    }
+  }
+
+  void grad_potential_batch(const path_ensemble<double> &paths,
+                            path_ensemble<double> &force) const {
+    assert(paths.get_path_length() == path_length);
+    assert(force.get_path_length() == path_length);
+    assert(force.num_paths() == paths.num_paths());
+
+    // Site major layout: the neighbours of entry j are j - K and j + K
+    const auto K = paths.num_paths();
+    const auto last = (path_length - 1) * K;
+    const double *__restrict x = paths.data();
+    double *__restrict f = force.data();
+
+    for (std::size_t k = 0; k < K; ++k)
+      f[k] = site_force(x[k], x[last + k], x[K + k]);
+
+    for (std::size_t j = K; j < last; ++j)
+      f[j] = site_force(x[j], x[j - K], x[j + K]);
+
+    for (std::size_t k = 0; k < K; ++k)
+      f[last + k] = site_force(x[last + k], x[last - K + k], x[k]);
+  }
+
+  // Minimum of W (see above) for the neighbours x_m and x_p
+  double W_minimum(double x_m, double x_p) const {
+    const double K = 2. * m0 / delta_t;
+    const double mid = 0.5 * (x_m + x_p);
+
+    // Start from the minimum of the kinetic term
+    double x = mid;
+    for (std::size_t step = 0; step < n_newton_steps; ++step) {
+      const auto [dV, d2V] = derivatives(potential, x);
+      x -= (K * (x - mid) + delta_t * dV) / std::max(K + delta_t * d2V, 0.5 * K);
+    }
+    return x;
+  }
+
+  // Curvature W'' at the minimum
+  double W_curvature(double x_m, double x_p) const {
+    const double K = 2. * m0 / delta_t;
+    const auto d2V = derivatives(potential, W_minimum(x_m, x_p)).second;
+    return std::max(K + delta_t * d2V, 0.5 * K);
+  }
+
+  anharmonic_oscillator_action make_coarsened_action() const {
+    return {path_length / 2, 2 * delta_t, m0, potential};
+  }
+
+  anharmonic_oscillator_action make_finer_action() const {
+    return {2 * path_length, delta_t / 2, m0, potential};
+  }
+
+  std::size_t get_path_length() const { return path_length; }
+  double get_delta_t() const { return delta_t; }
+  const Potential &get_potential() const { return potential; }
+
+  // Writes the parameters, e.g., for single_level_mcmc::set_checkpoint_parameters
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(path_length, delta_t, m0, potential);
+  }
+
+private:
+  // Potential of site x and kinetic term of the link to its left neighbour x_m
+  double site_action(double x, double x_m) const {
+    const auto dx = x - x_m;
+    return 0.5 * m0 / delta_t * dx * dx + delta_t * potential(x);
+  }
+
+  double site_force(double x, double x_m, double x_p) const {
+    return m0 / delta_t * (2. * x - x_m - x_p) + delta_t * derivative(potential, x);
+  }
+
+  std::size_t path_length;
+  double delta_t;
+  double m0;
+
+  Potential potential;
+};
+
+} // namespace mlmcpi
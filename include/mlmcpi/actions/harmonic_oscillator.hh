@@ -1,8 +1,11 @@
 #pragma once
 
+#include "mlmcpi/common/path_ensemble.hh"
+
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <vector>
 
 namespace mlmcpi {
 
@@ -15,10 +18,11 @@ template <typename TPathType> struct harmonic_oscillator_action {
         delta_t{delta_t_},
         m0{m0_},
         mu2{mu2_},
-        W_curvature_((2. / delta_t + delta_t * mu2) * m0),
-        W_minimum_scaling(0.5 / (1. + 0.5 * delta_t * delta_t * mu2)) {}
+        W_curvature_(2. * m0 / delta_t + delta_t * mu2),
+        W_minimum_scaling(0.5 / (1. + 0.5 * delta_t * delta_t * mu2 / m0)) {}
 
-  double evaluate(const PathType &path) const {
+  // `path` may also be a view of a path, see partition.hh
+  template <typename Vector> double evaluate(const Vector &path) const {
     assert(path.size() == path_length);
 
     // First term is computed separately using periodic BCs
@@ -36,22 +40,97 @@ template <typename TPathType> struct harmonic_oscillator_action {
   }
 
   PathType grad_potential(const PathType &path) const {
+    PathType force(path.size());
+    grad_potential_into(path, force);
+    return force;
+  }
+
+  // Same as grad_potential but writes into the preallocated vector `force`
+  void grad_potential_into(const PathType &path, PathType &force) const {
     assert(path.size() == path_length);
+    assert(force.size() == path.size());
 
-    PathType force(path.size());
+    const auto n = path.size();
 
-    double A = m0 / delta_t;
-    double B = 2. + delta_t * delta_t * mu2;
+    const double A = m0 / delta_t;
+    const double B = 2. + delta_t * delta_t * mu2 / m0;
 
-    force[0] = A * (B * path[0] - path[path.size() - 1] - path[1]);
+    force[0] = A * (B * path[0] - path[n - 1] - path[1]);
 
-    for (std::size_t i = 1; i < path.size() - 1; ++i)
+    for (std::size_t i = 1; i < n - 1; ++i)
       force[i] = A * (B * path[i] - path[i - 1] - path[i + 1]);
 
-    force[path.size() - 1] =
-        A * (B * path[path.size() - 1] - path[path.size() - 2] - path[0]);
+    force[n - 1] = A * (B * path[n - 1] - path[n - 2] - path[0]);
+  }
 
-    return force;
+  /*
+    Batched versions of evaluate and grad_potential_into for all paths of an ensemble
+    (see path_ensemble.hh). The periodic boundary is treated once per site (or once per
+    ensemble), all other loops run over the paths with unit stride.
+   */
+  void evaluate_batch(const path_ensemble<double> &paths,
+                      std::vector<double> &res) const {
+    assert(paths.get_path_length() == path_length);
+    const auto n_paths = paths.num_paths();
+    res.assign(n_paths, 0.);
+
+    double *__restrict r = res.data();
+    for (std::size_t i = 0; i < path_length; ++i) {
+      const double *__restrict x = paths.site(i);
+      const double *__restrict x_m = paths.site(i == 0 ? path_length - 1 : i - 1);
+
+      for (std::size_t k = 0; k < n_paths; ++k) {
+        const auto dxdt = (x[k] - x_m[k]) / delta_t;
+        r[k] += m0 * dxdt * dxdt + mu2 * x[k] * x[k];
+      }
+    }
+
+    for (std::size_t k = 0; k < n_paths; ++k)
+      r[k] *= 0.5 * delta_t;
+  }
+
+  void grad_potential_batch(const path_ensemble<double> &paths,
+                            path_ensemble<double> &force) const {
+    assert(paths.get_path_length() == path_length);
+    assert(force.get_path_length() == path_length);
+    assert(force.num_paths() == paths.num_paths());
+    const auto n_paths = paths.num_paths();
+
+    const double A = m0 / delta_t;
+    const double B = 2. + delta_t * delta_t * mu2 / m0;
+
+    // In the site major layout the neighbours of entry j are j - K and j + K, so all
+    // sites but the two boundary ones are processed in a single unit stride loop
+    const auto K = n_paths;
+    const auto last = (path_length - 1) * K;
+    const double *__restrict x = paths.data();
+    double *__restrict f = force.data();
+
+    for (std::size_t k = 0; k < K; ++k)
+      f[k] = A * (B * x[k] - x[last + k] - x[K + k]);
+
+    for (std::size_t j = K; j < last; ++j)
+      f[j] = A * (B * x[j] - x[j - K] - x[j + K]);
+
+    for (std::size_t k = 0; k < K; ++k)
+      f[last + k] = A * (B * x[last + k] - x[last - K + k] - x[k]);
+  }
+
+  /*
+    The action is the quadratic form 0.5 * x^T C x with a circulant matrix C. Returns the
+    first column of C, i.e., the stencil used in grad_potential.
+   */
+  std::vector<double> circulant_kernel() const {
+    assert(path_length >= 2);
+
+    const double A = m0 / delta_t;
+    const double B = 2. + delta_t * delta_t * mu2 / m0;
+
+    std::vector<double> kernel(path_length, 0.);
+    kernel[0] = A * B;
+    kernel[1] -= A;
+    kernel[path_length - 1] -= A;
+    return kernel;
   }
 
   inline double W_curvature(double /*x_m*/, double /*x_p*/) const { return W_curvature_; }
@@ -59,21 +138,22 @@ template <typename TPathType> struct harmonic_oscillator_action {
     return W_minimum_scaling * (x_m + x_p);
   }
 
+  // The W_* coefficients depend on delta_t, so the actions are constructed anew
   harmonic_oscillator_action make_coarsened_action() const {
-    auto coarse_action(*this);
-    coarse_action.delta_t *= 2;
-    coarse_action.path_length /= 2;
-    return coarse_action;
+    return {path_length / 2, 2 * delta_t, m0, mu2};
   }
 
   harmonic_oscillator_action make_finer_action() const {
-    auto coarse_action(*this);
-    coarse_action.delta_t /= 2;
-    coarse_action.path_length *= 2;
-    return coarse_action;
+    return {2 * path_length, delta_t / 2, m0, mu2};
   }
 
   std::size_t get_path_length() const { return path_length; }
+  double get_delta_t() const { return delta_t; }
+
+  // Writes the parameters, e.g., for single_level_mcmc::set_checkpoint_parameters
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(path_length, delta_t, m0, mu2);
+  }
 
 private:
   std::size_t path_length;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "mlmcpi/common/fft.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Integrated autocorrelation time tau = 1 + 2 sum_{t=1}^{W} rho(t) together with its
+  statistical error and the summation window W that was used. tau is defined such that
+  the error of the mean of n samples is sqrt(tau * var / n).
+ */
+struct autocorr_time {
+  double tau = 1.;
+  double error = 0.;
+  std::size_t window = 0;
+};
+
+/*
+  Normalised autocorrelation function rho(t), t = 0, ..., n-1, of a time series. The
+  autocovariance is computed in O(n log n) as the inverse FFT of the power spectrum of
+  the series, zero-padded to (at least) twice its length to avoid wrap-around.
+ */
+template <typename DataT>
+std::vector<double> autocorrelation_function(const std::vector<DataT> &samples) {
+  const auto n = samples.size();
+  if (n == 0)
+    return {};
+
+  double m = 0;
+  for (const auto &x : samples)
+    m += x;
+  m /= static_cast<double>(n);
+
+  const auto padded_size = next_power_of_two(2 * n);
+  std::vector<std::complex<double>> data(padded_size);
+  for (std::size_t i = 0; i < n; ++i)
+    data[i] = samples[i] - m;
+
+  fft_plan plan(padded_size);
+  plan.forward(data);
+  for (auto &x : data)
+    x = std::norm(x);
+  plan.inverse(data);
+
+  std::vector<double> rho(n);
+  const auto c0 = data[0].real();
+  if (c0 <= 0) {
+    // Constant series
+    rho[0] = 1.;
+    return rho;
+  }
+
+  for (std::size_t t = 0; t < n; ++t)
+    rho[t] = data[t].real() / c0;
+  return rho;
+}
+
+/*
+  Estimates the integrated autocorrelation time with Sokal's self-consistent window: the
+  window W is the smallest lag with W >= c * tau_int(W), where tau_int = tau / 2 is the
+  autocorrelation time in Sokal's normalisation. The error follows Madras & Sokal,
+  Var(tau) ~ 2 (2W + 1) / n * tau^2.
+ */
+template <typename DataT>
+autocorr_time integrated_autocorr_time(const std::vector<DataT> &samples, double c = 5.) {
+  const auto n = samples.size();
+  if (n < 2)
+    return {};
+
+  const auto rho = autocorrelation_function(samples);
+
+  double tau = 1.;
+  std::size_t window = 1;
+  for (; window < n; ++window) {
+    tau += 2 * rho[window];
+    if (static_cast<double>(window) >= 0.5 * c * tau)
+      break;
+  }
+  window = std::min(window, n - 1);
+
+  // tau can become smaller than one for anticorrelated chains; clamp it as in the
+  // batch means estimate
+  tau = std::max(tau, 1.);
+
+  const auto error = tau * std::sqrt(2. * (2. * static_cast<double>(window) + 1.) /
+                                     static_cast<double>(n));
+  return {tau, error, window};
+}
+
+} // namespace mlmcpi
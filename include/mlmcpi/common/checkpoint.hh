@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
+namespace mlmcpi {
+
+/*
+  Compact binary serialisation for checkpoints. A value is written as
+  - value.save(writer), if it provides it (paths, states, samplers, results, ...)
+  - its object representation, if it is trivially copyable (numbers, counter-based
+    engines, ...)
+  - its size followed by its elements, if it is a contiguous container (std::vector,
+    std::string, blaze vectors, ...)
+  - its text representation, if it can only be streamed (e.g., standard engines that
+    are not trivially copyable)
+  and read back in the same way. The format is meant for restarting the same binary on
+  the same machine, so no attempt is made to make it portable.
+ */
+class binary_writer {
+public:
+  template <typename T> void write(const T &value) {
+    if constexpr (requires { value.save(*this); }) {
+      value.save(*this);
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+      write_bytes(&value, sizeof(T));
+    } else if constexpr (requires { value.data(), value.size(); }) {
+      write(static_cast<std::uint64_t>(value.size()));
+      using Element = std::remove_cvref_t<decltype(*value.data())>;
+      if constexpr (std::is_trivially_copyable_v<Element>)
+        write_bytes(value.data(), value.size() * sizeof(Element));
+      else
+        for (std::size_t i = 0; i < value.size(); ++i)
+          write(value.data()[i]);
+    } else {
+      std::ostringstream stream;
+      stream << value;
+      write(stream.str());
+    }
+  }
+
+  template <typename... Ts> void write_all(const Ts &...values) { (write(values), ...); }
+
+  const std::vector<char> &get_buffer() const { return buffer; }
+
+private:
+  void write_bytes(const void *data, std::size_t size) {
+    const auto *bytes = static_cast<const char *>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+  }
+
+  std::vector<char> buffer;
+};
+
+class binary_reader {
+public:
+  explicit binary_reader(std::vector<char> buffer_) : buffer{std::move(buffer_)} {}
+
+  // Returns false if the buffer ended before `value` was read completely
+  template <typename T> bool read(T &value) {
+    if constexpr (requires { value.load(*this); }) {
+      value.load(*this);
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+      read_bytes(&value, sizeof(T));
+    } else if constexpr (requires { value.data(), value.size(), value.resize(0); }) {
+      std::uint64_t size = 0;
+      read(size);
+      value.resize(ok ? static_cast<std::size_t>(size) : 0);
+
+      using Element = std::remove_cvref_t<decltype(*value.data())>;
+      if constexpr (std::is_trivially_copyable_v<Element>)
+        read_bytes(value.data(), value.size() * sizeof(Element));
+      else
+        for (std::size_t i = 0; i < value.size(); ++i)
+          read(value.data()[i]);
+    } else {
+      std::string text;
+      read(text);
+      std::istringstream stream(text);
+      stream >> value;
+    }
+    return ok;
+  }
+
+  template <typename... Ts> bool read_all(Ts &...values) {
+    (read(values), ...);
+    return ok;
+  }
+
+  bool good() const { return ok; }
+  bool at_end() const { return position == buffer.size(); }
+
+private:
+  void read_bytes(void *data, std::size_t size) {
+    if (not ok || buffer.size() - position < size) {
+      ok = false;
+      return;
+    }
+    if (size > 0)
+      std::memcpy(data, buffer.data() + position, size);
+    position += size;
+  }
+
+  std::vector<char> buffer;
+  std::size_t position = 0;
+  bool ok = true;
+};
+
+/*
+  Types with state that has to survive a restart, e.g., samplers with tuned parameters.
+  They provide `template <typename Writer> void save(Writer &) const` and the matching
+  load, which write and read their members with write_all and read_all.
+ */
+template <typename T>
+concept checkpointable = requires(const T &t, T &u, binary_writer &w, binary_reader &r) {
+  t.save(w);
+  u.load(r);
+};
+
+namespace detail {
+inline constexpr std::array<char, 8> checkpoint_magic{'M', 'L', 'M', 'C',
+                                                      'P', 'I', 'C', 'K'};
+inline constexpr std::uint32_t checkpoint_version = 5;
+
+// FNV-1a, detects truncated and corrupted files
+inline std::uint64_t checksum(const std::vector<char> &data) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (const auto c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+} // namespace detail
+
+/*
+  Writes the contents of `writer` to `path` atomically: the data is written to a
+  temporary file next to `path`, flushed to disk and then renamed, so a crash during
+  the write leaves the previous checkpoint intact. Returns false on failure.
+ */
+inline bool write_checkpoint(const std::string &path, const binary_writer &writer) {
+  const auto &payload = writer.get_buffer();
+
+  binary_writer file_contents;
+  file_contents.write_all(detail::checkpoint_magic, detail::checkpoint_version,
+                          detail::checksum(payload), payload);
+  const auto &data = file_contents.get_buffer();
+
+  const auto tmp_path = path + ".tmp";
+  std::FILE *file = std::fopen(tmp_path.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  ok = std::fflush(file) == 0 && ok;
+#if __has_include(<unistd.h>)
+  ok = ::fsync(::fileno(file)) == 0 && ok;
+#endif
+  ok = std::fclose(file) == 0 && ok;
+
+  if (not ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+/*
+  Reads a checkpoint written by write_checkpoint. Returns an empty optional if the file
+  does not exist, is not a checkpoint of this version or is corrupted.
+ */
+inline std::optional<binary_reader> read_checkpoint(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return {};
+
+  std::vector<char> data;
+  std::array<char, 4096> chunk;
+  std::size_t n_read = 0;
+  while ((n_read = std::fread(chunk.data(), 1, chunk.size(), file)) > 0)
+    data.insert(data.end(), chunk.data(), chunk.data() + n_read);
+  std::fclose(file);
+
+  binary_reader file_contents(std::move(data));
+  std::array<char, 8> magic{};
+  std::uint32_t version = 0;
+  std::uint64_t checksum = 0;
+  std::vector<char> payload;
+  if (not file_contents.read_all(magic, version, checksum, payload) ||
+      not file_contents.at_end() || magic != detail::checkpoint_magic ||
+      version != detail::checkpoint_version || checksum != detail::checksum(payload))
+    return {};
+
+  return binary_reader(std::move(payload));
+}
+
+} // namespace mlmcpi
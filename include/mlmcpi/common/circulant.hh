@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mlmcpi/common/fft.hh"
+
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Symmetric circulant operator C, defined by its first column (the kernel) c, i.e.,
+  (Cx)_i = sum_j c_{(i - j) mod n} x_j. C is diagonalised by the discrete Fourier
+  transform, its eigenvalues being the DFT of the kernel. Functions f(C) are therefore
+  applied in O(n log n) by scaling the Fourier modes with f(lambda_k).
+
+  Holds FFT scratch storage, so it must not be shared between threads.
+ */
+class circulant_operator {
+public:
+  circulant_operator() = default;
+
+  explicit circulant_operator(const std::vector<double> &kernel)
+      : plan(kernel.size()),
+        buffer(kernel.size()) {
+    const auto n = kernel.size();
+    for (std::size_t i = 0; i < n; ++i) {
+      assert(std::abs(kernel[i] - kernel[(n - i) % n]) < 1e-12 * std::abs(kernel[0]));
+      buffer[i] = kernel[i];
+    }
+
+    plan.forward(buffer);
+
+    eigenvalues.resize(n);
+    for (std::size_t k = 0; k < n; ++k)
+      eigenvalues[k] = buffer[k].real();
+  }
+
+  std::size_t size() const { return eigenvalues.size(); }
+
+  const std::vector<double> &get_eigenvalues() const { return eigenvalues; }
+
+  // lambda_k^power for all modes; used to precompute the multipliers for apply_spectral
+  std::vector<double> spectrum_power(double power) const {
+    std::vector<double> res(eigenvalues.size());
+    for (std::size_t k = 0; k < res.size(); ++k) {
+      assert(eigenvalues[k] > 0 || power >= 0);
+      res[k] = std::pow(eigenvalues[k], power);
+    }
+    return res;
+  }
+
+  /*
+    out = F^{-1} diag(multipliers) F in. `in` and `out` may be the same vector. The
+    multipliers have to be symmetric (m_k = m_{n-k}) for the result to be real.
+   */
+  template <typename InVector, typename OutVector>
+  void apply_spectral(const InVector &in, OutVector &out,
+                      const std::vector<double> &multipliers) {
+    const auto n = eigenvalues.size();
+    assert(in.size() == n && out.size() == n && multipliers.size() == n);
+
+    for (std::size_t i = 0; i < n; ++i)
+      buffer[i] = in[i];
+
+    plan.forward(buffer);
+    for (std::size_t k = 0; k < n; ++k)
+      buffer[k] *= multipliers[k];
+    plan.inverse(buffer);
+
+    for (std::size_t i = 0; i < n; ++i)
+      out[i] = buffer[i].real();
+  }
+
+  template <typename InVector, typename OutVector>
+  void apply(const InVector &in, OutVector &out) {
+    apply_spectral(in, out, eigenvalues);
+  }
+
+private:
+  fft_plan plan;
+  std::vector<std::complex<double>> buffer;
+  std::vector<double> eigenvalues;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "mlmcpi/common/autocorrelation.hh"
+#include "mlmcpi/common/mcmc_result.hh"
+#include "mlmcpi/common/streaming_statistics.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  A sample of a QOI Q together with a reference QOI R measured on the same path (see
+  qoi/control_variate.hh). Stored as two contiguous values, so it can be written to
+  traces and checkpoints as is.
+ */
+struct control_variate_sample {
+  std::array<double, 2> values{};
+
+  double value() const { return values[0]; }
+  double reference() const { return values[1]; }
+
+  const double *data() const { return values.data(); }
+  static constexpr std::size_t size() { return 2; }
+};
+
+/*
+  Result with a control variate: <Q> is estimated by the mean of
+    Q - beta (R - <R>)
+  where <R> is the known expectation of the reference QOI under the distribution that
+  is sampled. For every beta this has the mean <Q>; its variance is smallest for
+  beta = Cov(Q, R) / Var(R), by the factor 1 / (1 - corr(Q, R)^2). This coefficient is
+  fitted online from the running covariance of all samples (which adds a bias of order
+  1 / n only).
+
+  The estimate is only unbiased if <R> is exact for the sampled action: the expectation
+  under another action, e.g., the analytic <x^2> of the harmonic oscillator in an
+  anharmonic run, shifts it by beta times the difference, which mean_error() does not
+  include. For a general action, <R> has to follow from the action itself, e.g., the
+  site average of x_i dS/dx_i has the expectation 1 for every action (integration by
+  parts).
+
+  The coefficient and the error do not depend on <R>, which only enters the estimate, so
+  it is passed to mean(). The error is estimated with batch means (see
+  streaming_statistics.hh) of Q - beta R, so it includes the autocorrelation. The plain
+  estimate of <Q> without the control variate is kept for comparison.
+ */
+template <> class mcmc_result<control_variate_sample> {
+public:
+  explicit mcmc_result(bool keep_samples_ = false) : keep_samples{keep_samples_} {}
+
+  void add_sample(const control_variate_sample &sample, bool was_accepted) {
+    add_sample(sample, 1, was_accepted ? 1 : 0);
+  }
+
+  void add_sample(const control_variate_sample &sample, std::size_t n_steps,
+                  std::size_t n_accepted) {
+    total_samples++;
+    total_steps += n_steps;
+    accepted_steps += n_accepted;
+
+    // Welford update of the co-moment, sum (q - <q>) (r - <r>)
+    const auto delta_q = sample.value() - q.mean();
+    q.add(sample.value());
+    r.add(sample.reference());
+    comoment += delta_q * (sample.reference() - r.mean());
+
+    if (keep_samples)
+      samples.push_back(sample);
+  }
+
+  // Estimate of <Q>, given the exact expectation of the reference QOI for the sampled
+  // action (see above)
+  double mean(double reference_mean) const {
+    return q.mean() - coefficient() * (r.mean() - reference_mean);
+  }
+
+  // Infinite until the batches are long enough, see streaming_statistics
+  double mean_error() const {
+    if (not batches_converged())
+      return std::numeric_limits<double>::infinity();
+
+    return std::sqrt(batch_variance(coefficient()) /
+                     static_cast<double>(q.num_batches()));
+  }
+
+  double max_mean_error() const { return mean_error(); }
+
+  // Variance of Q - beta R
+  double variance() const {
+    const auto beta = coefficient();
+    const auto var = q.variance() - 2 * beta * covariance() + beta * beta * r.variance();
+    return std::max(0., var);
+  }
+
+  // The fitted coefficient beta = Cov(Q, R) / Var(R)
+  double coefficient() const {
+    const auto var_r = r.variance();
+    return var_r > 0 ? covariance() / var_r : 0.;
+  }
+
+  double covariance() const {
+    return total_samples < 2 ? 0. : comoment / static_cast<double>(total_samples - 1);
+  }
+
+  double correlation() const {
+    const auto norm = std::sqrt(q.variance() * r.variance());
+    return norm > 0 ? covariance() / norm : 0.;
+  }
+
+  /*
+    Factor by which the control variate reduces the squared error, i.e., the number of
+    samples needed for a given error. Both errors are estimated from the same batches.
+   */
+  double variance_reduction() const {
+    if (q.num_batches() < 2)
+      return 1.;
+
+    const auto var = batch_variance(coefficient());
+    return var > 0 ? batch_variance(0.) / var : std::numeric_limits<double>::infinity();
+  }
+
+  // Estimate of <Q> without the control variate
+  double plain_mean() const { return q.mean(); }
+  double plain_mean_error() const { return q.mean_error(); }
+
+  // Sample mean of the reference QOI, to be compared with its expectation
+  double reference_mean() const { return r.mean(); }
+  double reference_mean_error() const { return r.mean_error(); }
+
+  double acceptance_rate() const { return (1. * accepted_steps) / total_steps; }
+
+  // Autocorrelation time of Q - beta R, see the scalar mcmc_result
+  autocorr_time integrated_autocorr_time(double c = 5.) const {
+    const auto beta = coefficient();
+    if (keep_samples) {
+      std::vector<double> series(samples.size());
+      for (std::size_t i = 0; i < samples.size(); ++i)
+        series[i] = samples[i].value() - beta * samples[i].reference();
+      return mlmcpi::integrated_autocorr_time(series, c);
+    }
+
+    const auto n_batches = q.num_batches();
+    if (n_batches < 2 || variance() <= 0)
+      return {};
+
+    const auto tau = batch_autocorr_time(beta);
+    const auto error = tau * std::sqrt(2. / static_cast<double>(n_batches - 1));
+    return {tau, error, q.get_batch_size()};
+  }
+
+  std::size_t num_samples() const { return total_samples; }
+  std::size_t num_steps() const { return total_steps; }
+  double steps_per_sample() const { return (1. * total_steps) / total_samples; }
+
+  bool has_samples() const { return keep_samples; }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(keep_samples, samples, q, r, comoment, total_samples, total_steps,
+                     accepted_steps);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(keep_samples, samples, q, r, comoment, total_samples, total_steps,
+                    accepted_steps);
+  }
+
+  // Only filled if the result was constructed with keep_samples = true
+  std::vector<control_variate_sample> samples;
+
+private:
+  // Batch means estimate of the autocorrelation time of Q - beta R
+  double batch_autocorr_time(double beta) const {
+    const auto var = variance();
+    if (q.num_batches() < 2 || var <= 0)
+      return 1.;
+
+    const auto batch_size = static_cast<double>(q.get_batch_size());
+    return std::max(1., batch_size * batch_variance(beta) / var);
+  }
+
+  // Same criterion as streaming_statistics::batches_converged, applied to Q - beta R
+  bool batches_converged() const {
+    using statistics = streaming_statistics<double>;
+    const auto batch_size = q.get_batch_size();
+    if (batch_size < statistics::min_batch_size)
+      return false;
+
+    return static_cast<double>(batch_size) >=
+           static_cast<double>(statistics::min_batch_autocorr_times) *
+               batch_autocorr_time(coefficient());
+  }
+
+  // Variance of the batch means of Q - beta R; q and r are batched in lock-step
+  double batch_variance(double beta) const {
+    const auto &q_batches = q.get_batch_means();
+    const auto &r_batches = r.get_batch_means();
+    const auto n_batches = q_batches.size();
+    if (n_batches < 2)
+      return std::numeric_limits<double>::infinity();
+
+    double m = 0;
+    for (std::size_t i = 0; i < n_batches; ++i)
+      m += q_batches[i] - beta * r_batches[i];
+    m /= static_cast<double>(n_batches);
+
+    double sum_sq = 0;
+    for (std::size_t i = 0; i < n_batches; ++i) {
+      const auto d = q_batches[i] - beta * r_batches[i] - m;
+      sum_sq += d * d;
+    }
+    return sum_sq / static_cast<double>(n_batches - 1);
+  }
+
+  bool keep_samples;
+  streaming_statistics<double> q;
+  streaming_statistics<double> r;
+  double comoment = 0;
+
+  std::size_t total_samples = 0;
+  std::size_t total_steps = 0;
+  std::size_t accepted_steps = 0;
+};
+
+} // namespace mlmcpi
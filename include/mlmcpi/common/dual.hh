@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cmath>
+
+namespace mlmcpi {
+
+/*
+  Forward-mode dual numbers a + b eps with eps^2 = 0: evaluating f(x + eps) gives
+  f(x) + f'(x) eps. Functions written as templates in their argument type (e.g., the
+  potentials in anharmonic_oscillator.hh) are thus differentiated by the compiler; all
+  operations are inlined, so the derivative costs a few extra multiplications and
+  vectorises like the function itself. Nesting, dual<dual<double>>, gives the second
+  derivative.
+
+  The elementary functions are found by argument-dependent lookup, so generic code calls
+  them unqualified after `using std::exp;` etc.
+ */
+template <typename T> struct dual {
+  T value{};
+  T derivative{};
+
+  constexpr dual() = default;
+  constexpr dual(double value_) : value(value_), derivative(0.) {}
+  constexpr dual(T value_, T derivative_) : value{value_}, derivative{derivative_} {}
+
+  constexpr dual &operator+=(const dual &other) { return *this = *this + other; }
+  constexpr dual &operator-=(const dual &other) { return *this = *this - other; }
+  constexpr dual &operator*=(const dual &other) { return *this = *this * other; }
+  constexpr dual &operator/=(const dual &other) { return *this = *this / other; }
+};
+
+template <typename T> constexpr dual<T> operator-(const dual<T> &a) {
+  return {-a.value, -a.derivative};
+}
+
+template <typename T> constexpr dual<T> operator+(const dual<T> &a, const dual<T> &b) {
+  return {a.value + b.value, a.derivative + b.derivative};
+}
+
+template <typename T> constexpr dual<T> operator-(const dual<T> &a, const dual<T> &b) {
+  return {a.value - b.value, a.derivative - b.derivative};
+}
+
+template <typename T> constexpr dual<T> operator*(const dual<T> &a, const dual<T> &b) {
+  return {a.value * b.value, a.derivative * b.value + a.value * b.derivative};
+}
+
+template <typename T> constexpr dual<T> operator/(const dual<T> &a, const dual<T> &b) {
+  return {a.value / b.value,
+          (a.derivative * b.value - a.value * b.derivative) / (b.value * b.value)};
+}
+
+// Mixed operations with constants, which have no derivative
+template <typename T> constexpr dual<T> operator+(const dual<T> &a, double b) {
+  return {a.value + b, a.derivative};
+}
+template <typename T> constexpr dual<T> operator+(double a, const dual<T> &b) {
+  return b + a;
+}
+template <typename T> constexpr dual<T> operator-(const dual<T> &a, double b) {
+  return {a.value - b, a.derivative};
+}
+template <typename T> constexpr dual<T> operator-(double a, const dual<T> &b) {
+  return {a - b.value, -b.derivative};
+}
+template <typename T> constexpr dual<T> operator*(const dual<T> &a, double b) {
+  return {a.value * b, a.derivative * b};
+}
+template <typename T> constexpr dual<T> operator*(double a, const dual<T> &b) {
+  return b * a;
+}
+template <typename T> constexpr dual<T> operator/(const dual<T> &a, double b) {
+  return {a.value / b, a.derivative / b};
+}
+template <typename T> constexpr dual<T> operator/(double a, const dual<T> &b) {
+  return dual<T>(a) / b;
+}
+
+template <typename T> dual<T> exp(const dual<T> &a) {
+  using std::exp;
+  const auto e = exp(a.value);
+  return {e, e * a.derivative};
+}
+
+template <typename T> dual<T> log(const dual<T> &a) {
+  using std::log;
+  return {log(a.value), a.derivative / a.value};
+}
+
+template <typename T> dual<T> sqrt(const dual<T> &a) {
+  using std::sqrt;
+  const auto s = sqrt(a.value);
+  return {s, a.derivative / (2. * s)};
+}
+
+template <typename T> dual<T> sin(const dual<T> &a) {
+  using std::cos, std::sin;
+  return {sin(a.value), cos(a.value) * a.derivative};
+}
+
+template <typename T> dual<T> cos(const dual<T> &a) {
+  using std::cos, std::sin;
+  return {cos(a.value), -sin(a.value) * a.derivative};
+}
+
+template <typename T> dual<T> cosh(const dual<T> &a) {
+  using std::cosh, std::sinh;
+  return {cosh(a.value), sinh(a.value) * a.derivative};
+}
+
+template <typename T> dual<T> sinh(const dual<T> &a) {
+  using std::cosh, std::sinh;
+  return {sinh(a.value), cosh(a.value) * a.derivative};
+}
+
+// f'(x)
+template <typename F> constexpr double derivative(const F &f, double x) {
+  return f(dual<double>{x, 1.}).derivative;
+}
+
+/*
+  f'(x) and f''(x) in one evaluation with nested dual numbers: with
+  x = (x + eps_1) + (1 + 0 eps_1) eps_2, f(x) = (f + f' eps_1) + (f' + f'' eps_1) eps_2.
+ */
+struct second_order_derivatives {
+  double first;
+  double second;
+};
+
+template <typename F>
+constexpr second_order_derivatives derivatives(const F &f, double x) {
+  const auto res = f(dual<dual<double>>{{x, 1.}, {1., 0.}});
+  return {res.derivative.value, res.derivative.derivative};
+}
+
+} // namespace mlmcpi
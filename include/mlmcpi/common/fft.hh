@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <numbers>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+
+inline std::size_t next_power_of_two(std::size_t n) {
+  std::size_t m = 1;
+  while (m < n)
+    m *= 2;
+  return m;
+}
+
+/*
+  Precomputed discrete Fourier transform of a fixed length n.
+
+  Powers of two are handled by an iterative radix-2 algorithm. Other lengths are reduced
+  to a cyclic convolution of power-of-two length using Bluestein's chirp-z algorithm, so
+  every transform costs O(n log n). The plan owns scratch storage and is therefore not
+  thread-safe; use one plan per thread.
+
+  The forward transform computes X_k = sum_j x_j exp(-2 pi i jk / n), the inverse
+  transform includes the factor 1/n.
+ */
+class fft_plan {
+public:
+  using Complex = std::complex<double>;
+
+  fft_plan() = default;
+
+  explicit fft_plan(std::size_t n_) : n{n_} {
+    assert(n > 0);
+
+    if (is_power_of_two(n)) {
+      init_radix2(n, twiddles, bit_reversal);
+      return;
+    }
+
+    // Bluestein: w_k = exp(-i pi k^2 / n). k^2 is reduced modulo 2n to keep the argument
+    // of the exponential small.
+    m = next_power_of_two(2 * n - 1);
+    init_radix2(m, twiddles, bit_reversal);
+
+    chirp.resize(n);
+    for (std::size_t k = 0; k < n; ++k) {
+      const auto k2 = (k * k) % (2 * n);
+      chirp[k] = std::polar(1., -std::numbers::pi * static_cast<double>(k2) /
+                                    static_cast<double>(n));
+    }
+
+    chirp_hat.assign(m, Complex{0});
+    chirp_hat[0] = std::conj(chirp[0]);
+    for (std::size_t k = 1; k < n; ++k)
+      chirp_hat[k] = chirp_hat[m - k] = std::conj(chirp[k]);
+    radix2(chirp_hat, false);
+
+    scratch.resize(m);
+  }
+
+  std::size_t size() const { return n; }
+
+  void forward(std::vector<Complex> &data) { transform(data, false); }
+
+  void inverse(std::vector<Complex> &data) {
+    transform(data, true);
+
+    const auto scale = 1. / static_cast<double>(n);
+    for (auto &x : data)
+      x *= scale;
+  }
+
+private:
+  static bool is_power_of_two(std::size_t k) { return (k & (k - 1)) == 0; }
+
+  static void init_radix2(std::size_t len, std::vector<Complex> &tw,
+                          std::vector<std::size_t> &rev) {
+    tw.resize(len / 2);
+    for (std::size_t k = 0; k < len / 2; ++k)
+      tw[k] = std::polar(1., -2. * std::numbers::pi * static_cast<double>(k) /
+                                 static_cast<double>(len));
+
+    rev.resize(len);
+    std::size_t bits = 0;
+    while ((std::size_t{1} << bits) < len)
+      bits++;
+    for (std::size_t i = 0; i < len; ++i) {
+      std::size_t r = 0;
+      for (std::size_t b = 0; b < bits; ++b)
+        if (i & (std::size_t{1} << b))
+          r |= std::size_t{1} << (bits - 1 - b);
+      rev[i] = r;
+    }
+  }
+
+  // Unnormalised in-place transform of a power-of-two length vector
+  void radix2(std::vector<Complex> &a, bool inverse) const {
+    const auto len = a.size();
+    assert(len == bit_reversal.size());
+
+    for (std::size_t i = 0; i < len; ++i)
+      if (i < bit_reversal[i])
+        std::swap(a[i], a[bit_reversal[i]]);
+
+    for (std::size_t half = 1; half < len; half *= 2) {
+      const auto stride = len / (2 * half);
+      for (std::size_t start = 0; start < len; start += 2 * half) {
+        for (std::size_t j = 0; j < half; ++j) {
+          const auto w = inverse ? std::conj(twiddles[j * stride]) : twiddles[j * stride];
+          const auto u = a[start + j];
+          const auto v = a[start + j + half] * w;
+          a[start + j] = u + v;
+          a[start + j + half] = u - v;
+        }
+      }
+    }
+  }
+
+  void transform(std::vector<Complex> &data, bool inverse) {
+    assert(data.size() == n);
+
+    if (chirp.empty()) {
+      radix2(data, inverse);
+      return;
+    }
+
+    // The inverse transform is the conjugate of the forward transform of the conjugate
+    for (std::size_t k = 0; k < n; ++k)
+      scratch[k] = (inverse ? std::conj(data[k]) : data[k]) * chirp[k];
+    std::fill(scratch.begin() + static_cast<std::ptrdiff_t>(n), scratch.end(),
+              Complex{0});
+
+    radix2(scratch, false);
+    for (std::size_t k = 0; k < m; ++k)
+      scratch[k] *= chirp_hat[k];
+    radix2(scratch, true);
+
+    const auto scale = 1. / static_cast<double>(m);
+    for (std::size_t k = 0; k < n; ++k) {
+      const auto x = scratch[k] * scale * chirp[k];
+      data[k] = inverse ? std::conj(x) : x;
+    }
+  }
+
+  std::size_t n = 0;
+  std::size_t m = 0; // Length of the padded convolution (Bluestein only)
+
+  std::vector<Complex> twiddles;
+  std::vector<std::size_t> bit_reversal;
+
+  std::vector<Complex> chirp;
+  std::vector<Complex> chirp_hat;
+  std::vector<Complex> scratch;
+};
+
+} // namespace mlmcpi
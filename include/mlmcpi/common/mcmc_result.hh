@@ -1,75 +1,225 @@
 #pragma once
 
+#include "mlmcpi/common/autocorrelation.hh"
+#include "mlmcpi/common/streaming_statistics.hh"
+
 #include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <concepts>
 #include <cstddef>
-#include <limits>
-#include <numeric>
+#include <type_traits>
 #include <vector>
 
 namespace mlmcpi {
+/*
+  Collects the QOI values of a Markov chain. By default only streaming statistics
+  (see streaming_statistics.hh) are accumulated, so memory usage does not grow with the
+  length of the chain. If `keep_samples` is set, the full trace is additionally stored in
+  `samples` for post-processing.
+ */
 template <typename DataT = double> class mcmc_result {
 public:
-  mcmc_result() {}
+  explicit mcmc_result(bool keep_samples_ = false) : keep_samples{keep_samples_} {}
 
   void add_sample(const DataT &sample, bool was_accepted) {
-    total_samples++;
+    add_sample(sample, 1, was_accepted ? 1 : 0);
+  }
 
-    samples.push_back(sample);
+  // Sample taken after `n_steps` steps of the chain (see thinning in single_level_mcmc),
+  // `n_accepted` of which were accepted
+  void add_sample(const DataT &sample, std::size_t n_steps, std::size_t n_accepted) {
+    total_samples++;
+    total_steps += n_steps;
+    accepted_steps += n_accepted;
 
-    if (was_accepted)
-      accepted_samples++;
+    statistics.add(sample);
+    if (keep_samples)
+      samples.push_back(sample);
   }
 
-  DataT mean(DataT zero = DataT{0}) const {
-    const auto sum =
-        std::reduce(samples.begin(), samples.end(), zero, std::plus<DataT>{});
-    return 1. / total_samples * sum;
+  DataT mean() const { return statistics.mean(); }
+
+  DataT mean_error() const { return statistics.mean_error(); }
+
+  // Same as mean_error(); the largest error of all components for vector-valued results
+  double max_mean_error() const { return static_cast<double>(mean_error()); }
+
+  DataT variance() const { return statistics.variance(); }
+
+  double acceptance_rate() const { return (1. * accepted_steps) / total_steps; }
+
+  /*
+    tau is measured in samples; for thinned samples, the autocorrelation time of the
+    chain in steps is approximately tau * steps_per_sample().
+
+    With a stored trace, tau is computed from the FFT-based autocorrelation function with
+    Sokal's automatic windowing (parameter c). Otherwise the batch means estimate is used;
+    its relative error is that of the sample variance of the batch means.
+   */
+  autocorr_time integrated_autocorr_time(double c = 5.) const {
+    if (keep_samples)
+      return mlmcpi::integrated_autocorr_time(samples, c);
+
+    const auto n_batches = statistics.num_batches();
+    if (n_batches < 2)
+      return {};
+
+    const auto tau = statistics.integrated_autocorr_time();
+    const auto error = tau * std::sqrt(2. / static_cast<double>(n_batches - 1));
+    return {tau, error, statistics.get_batch_size()};
   }
 
-  DataT mean_error() const {
-    return std::sqrt(((1.0 * integrated_autocorr_time()) / total_samples) * variance());
+  std::size_t num_samples() const { return total_samples; }
+
+  // Steps of the chain; larger than num_samples() if the samples were thinned
+  std::size_t num_steps() const { return total_steps; }
+  double steps_per_sample() const { return (1. * total_steps) / total_samples; }
+
+  bool has_samples() const { return keep_samples; }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(keep_samples, samples, statistics, total_samples, total_steps,
+                     accepted_steps);
   }
 
-  DataT variance() const {
-    const auto m = mean();
-    std::vector<DataT> diff(total_samples);
-    std::transform(samples.begin(), samples.end(), diff.begin(),
-                   [m](DataT x) { return x - m; });
-    const auto sum_sq =
-        std::inner_product(diff.begin(), diff.end(), diff.begin(), DataT{0});
-    return 1. / (total_samples - 1) * sum_sq;
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(keep_samples, samples, statistics, total_samples, total_steps,
+                    accepted_steps);
   }
 
-  double acceptance_rate() const { return (1. * accepted_samples) / total_samples; }
+  // Only filled if the result was constructed with keep_samples = true
+  std::vector<DataT> samples;
 
-  std::size_t integrated_autocorr_time(std::size_t window_size = 30) const {
-    if (window_size > total_samples)
-      return total_samples;
+private:
+  bool keep_samples;
+  streaming_statistics<DataT> statistics;
 
-    const auto m = mean();
+  std::size_t total_samples = 0;
+  std::size_t total_steps = 0;
+  std::size_t accepted_steps = 0;
+};
 
-    const auto rho = [&](std::size_t s) -> double {
-      double sum = 0;
-      for (std::size_t j = 1; j < total_samples - s; ++j)
-        sum += (samples[j] - m) * (samples[j + s] - m);
-      return 1. / (total_samples - s) * sum;
+// Vector-valued QOIs, e.g., std::vector<double>, std::array<double, n> or paths
+template <typename T>
+concept vector_valued =
+    not std::is_arithmetic_v<T> && requires(const T &v, std::size_t i) {
+      { v.size() } -> std::convertible_to<std::size_t>;
+      { v[i] } -> std::convertible_to<double>;
     };
 
-    double sum = 0;
-    const auto rho_zero = rho(0);
-    for (std::size_t s = 1; s < window_size; ++s)
-      sum += rho(s) / rho_zero;
-    const auto tau = static_cast<std::size_t>(std::ceil(1 + 2 * sum));
-    return std::max(1UL, tau);
+/*
+  Result for vector-valued QOIs (e.g., a correlator or several observables, see
+  qoi_set.hh). Every component is accumulated in its own streaming_statistics, so each
+  has its own mean, error and autocorrelation time. The number of components is fixed by
+  the first sample.
+ */
+template <typename DataT>
+  requires vector_valued<DataT>
+class mcmc_result<DataT> {
+public:
+  explicit mcmc_result(bool keep_samples_ = false) : keep_samples{keep_samples_} {}
+
+  void add_sample(const DataT &sample, bool was_accepted) {
+    add_sample(sample, 1, was_accepted ? 1 : 0);
+  }
+
+  void add_sample(const DataT &sample, std::size_t n_steps, std::size_t n_accepted) {
+    total_samples++;
+    total_steps += n_steps;
+    accepted_steps += n_accepted;
+
+    if (statistics.empty())
+      statistics.resize(sample.size());
+    assert(sample.size() == statistics.size());
+
+    for (std::size_t i = 0; i < statistics.size(); ++i)
+      statistics[i].add(static_cast<double>(sample[i]));
+    if (keep_samples)
+      samples.push_back(sample);
+  }
+
+  std::size_t num_components() const { return statistics.size(); }
+
+  double mean(std::size_t i) const { return statistics[i].mean(); }
+  double mean_error(std::size_t i) const { return statistics[i].mean_error(); }
+  double variance(std::size_t i) const { return statistics[i].variance(); }
+
+  std::vector<double> mean() const {
+    return collect([](const auto &s) { return s.mean(); });
+  }
+
+  std::vector<double> mean_error() const {
+    return collect([](const auto &s) { return s.mean_error(); });
+  }
+
+  std::vector<double> variance() const {
+    return collect([](const auto &s) { return s.variance(); });
+  }
+
+  double max_mean_error() const {
+    double res = 0;
+    for (const auto &s : statistics)
+      res = std::max(res, s.mean_error());
+    return res;
+  }
+
+  double acceptance_rate() const { return (1. * accepted_steps) / total_steps; }
+
+  // Autocorrelation time of component i, see the scalar mcmc_result
+  autocorr_time integrated_autocorr_time(std::size_t i, double c = 5.) const {
+    if (keep_samples) {
+      std::vector<double> series(samples.size());
+      for (std::size_t k = 0; k < samples.size(); ++k)
+        series[k] = static_cast<double>(samples[k][i]);
+      return mlmcpi::integrated_autocorr_time(series, c);
+    }
+
+    const auto &s = statistics[i];
+    if (s.num_batches() < 2)
+      return {};
+
+    const auto tau = s.integrated_autocorr_time();
+    const auto error = tau * std::sqrt(2. / static_cast<double>(s.num_batches() - 1));
+    return {tau, error, s.get_batch_size()};
   }
 
   std::size_t num_samples() const { return total_samples; }
 
+  // Steps of the chain; larger than num_samples() if the samples were thinned
+  std::size_t num_steps() const { return total_steps; }
+  double steps_per_sample() const { return (1. * total_steps) / total_samples; }
+
+  bool has_samples() const { return keep_samples; }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(keep_samples, samples, statistics, total_samples, total_steps,
+                     accepted_steps);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(keep_samples, samples, statistics, total_samples, total_steps,
+                    accepted_steps);
+  }
+
+  // Only filled if the result was constructed with keep_samples = true
   std::vector<DataT> samples;
 
 private:
+  template <typename F> std::vector<double> collect(F f) const {
+    std::vector<double> res(statistics.size());
+    for (std::size_t i = 0; i < statistics.size(); ++i)
+      res[i] = f(statistics[i]);
+    return res;
+  }
+
+  bool keep_samples;
+  std::vector<streaming_statistics<double>> statistics;
+
   std::size_t total_samples = 0;
-  std::size_t accepted_samples = 0;
+  std::size_t total_steps = 0;
+  std::size_t accepted_steps = 0;
 };
 } // namespace mlmcpi
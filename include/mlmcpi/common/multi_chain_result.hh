@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mlmcpi/common/mcmc_result.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Combines the results of several independent chains of equal length. The estimate is
+  the mean of the chain means, its error is computed from the (independent) errors of
+  the individual chains.
+ */
+template <typename DataT = double> class multi_chain_result {
+public:
+  explicit multi_chain_result(std::size_t n_chains, bool keep_samples = false)
+      : chains(n_chains, mcmc_result<DataT>(keep_samples)) {
+    assert(n_chains > 0);
+  }
+
+  DataT mean() const {
+    DataT sum{0};
+    for (const auto &chain : chains)
+      sum += chain.mean();
+    return sum / static_cast<DataT>(chains.size());
+  }
+
+  DataT mean_error() const {
+    DataT sum_sq{0};
+    for (const auto &chain : chains) {
+      const auto err = chain.mean_error();
+      sum_sq += err * err;
+    }
+    return std::sqrt(sum_sq) / static_cast<DataT>(chains.size());
+  }
+
+  /*
+    Gelman-Rubin potential scale reduction factor. Values close to one indicate that all
+    chains sample the same distribution.
+   */
+  DataT r_hat() const {
+    const auto n_chains = chains.size();
+    const auto n = static_cast<DataT>(chains[0].num_samples());
+    if (n_chains < 2 || n < 2)
+      return std::numeric_limits<DataT>::infinity();
+
+    const auto m = mean();
+    DataT within{0};
+    DataT between{0};
+    for (const auto &chain : chains) {
+      within += chain.variance();
+      between += (chain.mean() - m) * (chain.mean() - m);
+    }
+    within /= static_cast<DataT>(n_chains);
+    between /= static_cast<DataT>(n_chains - 1); // = B / n in Gelman's notation
+
+    if (within <= 0)
+      return DataT{1};
+
+    const auto var_plus = (n - 1) / n * within + between;
+    return std::sqrt(var_plus / within);
+  }
+
+  double acceptance_rate() const {
+    double sum = 0;
+    for (const auto &chain : chains)
+      sum += chain.acceptance_rate();
+    return sum / static_cast<double>(chains.size());
+  }
+
+  std::size_t num_samples() const {
+    std::size_t sum = 0;
+    for (const auto &chain : chains)
+      sum += chain.num_samples();
+    return sum;
+  }
+
+  std::size_t num_chains() const { return chains.size(); }
+
+  std::vector<mcmc_result<DataT>> chains;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mlmcpi/common/mcmc_result.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Result of the multilevel estimator E[Q_L] = E[Q_0] + sum_l E[Q_l - Q_{l-1}]. `levels[0]`
+  holds the samples of Q_0, `levels[l]` those of the correction Q_l - Q_{l-1}. The levels
+  are sampled independently, so the squared errors add up.
+ */
+template <typename DataT = double> class multilevel_result {
+public:
+  explicit multilevel_result(std::size_t n_levels)
+      : levels(n_levels),
+        cost_per_sample(n_levels, 0.) {
+    assert(n_levels > 0);
+  }
+
+  DataT mean() const {
+    DataT sum{0};
+    for (const auto &level : levels)
+      sum += level.mean();
+    return sum;
+  }
+
+  DataT mean_error() const {
+    DataT sum_sq{0};
+    for (const auto &level : levels) {
+      const auto err = level.mean_error();
+      sum_sq += err * err;
+    }
+    return std::sqrt(sum_sq);
+  }
+
+  // Total wall clock time in seconds spent for the samples on all levels
+  double total_cost() const {
+    double sum = 0;
+    for (std::size_t l = 0; l < levels.size(); ++l)
+      sum += cost_per_sample[l] * static_cast<double>(levels[l].num_samples());
+    return sum;
+  }
+
+  std::size_t num_levels() const { return levels.size(); }
+
+  std::vector<mcmc_result<DataT>> levels;
+
+  // Wall clock time in seconds per sample on every level
+  std::vector<double> cost_per_sample;
+};
+
+} // namespace mlmcpi
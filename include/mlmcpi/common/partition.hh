@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <tuple>
 
 namespace mlmcpi {
@@ -35,4 +37,57 @@ PathType combine_odd_even(const PathType &odd, const PathType &even) {
   return res;
 }
 
+/*
+  Non-owning view of the sites offset, offset + stride, offset + 2 * stride, ... of a
+  path. The even sites of a path are the path on the next coarser level, so the whole
+  level hierarchy can be addressed through views of the finest path: level l below the
+  finest one consists of every 2^l-th site. Views can be passed to everything that only
+  needs size() and operator[], e.g. the actions and the odd-even conditionals.
+
+  The view does not extend the lifetime of the path; use strided_view<const PathType>
+  for read-only access.
+ */
+template <typename PathType> class strided_view {
+public:
+  strided_view(PathType &path_, std::size_t offset_, std::size_t stride_)
+      : path{&path_},
+        offset{offset_},
+        stride{stride_} {
+    assert(stride > 0);
+  }
+
+  std::size_t size() const { return (path->size() - offset + stride - 1) / stride; }
+
+  decltype(auto) operator[](std::size_t i) const { return (*path)[offset + i * stride]; }
+
+  strided_view even() const { return {*path, offset, 2 * stride}; }
+  strided_view odd() const { return {*path, offset + stride, 2 * stride}; }
+
+private:
+  PathType *path;
+  std::size_t offset;
+  std::size_t stride;
+};
+
+template <typename PathType>
+strided_view<PathType> sub_lattice(PathType &path, std::size_t stride) {
+  return {path, 0, stride};
+}
+
+template <typename PathType> strided_view<PathType> even_sites(PathType &path) {
+  return {path, 0, 2};
+}
+
+template <typename PathType> strided_view<PathType> odd_sites(PathType &path) {
+  return {path, 1, 2};
+}
+
+// Copies `from` into `to` element by element; both may be paths or views
+template <typename FromVector, typename ToVector>
+void assign_sites(const FromVector &from, ToVector &&to) {
+  assert(from.size() == to.size());
+  for (std::size_t i = 0; i < from.size(); ++i)
+    to[i] = from[i];
+}
+
 } // namespace mlmcpi
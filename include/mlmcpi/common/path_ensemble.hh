@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  K paths of length N stored in structure-of-arrays layout: site major, chain minor, i.e.,
+  the value of chain k at site i is stored at i * K + k. All paths are at the same site
+  in the same cache line, so kernels that loop over the sites in the outer and over the
+  chains in the inner loop process all paths with contiguous, unit stride (SIMD) access
+  and treat boundary conditions once per site instead of once per path.
+ */
+template <typename DataT = double> class path_ensemble {
+public:
+  path_ensemble() = default;
+
+  path_ensemble(std::size_t path_length_, std::size_t n_paths_, DataT value = DataT{0})
+      : path_length{path_length_},
+        n_paths{n_paths_},
+        values(path_length_ * n_paths_, value) {}
+
+  std::size_t get_path_length() const { return path_length; }
+  std::size_t size() const { return path_length; }
+  std::size_t num_paths() const { return n_paths; }
+
+  DataT &operator()(std::size_t site, std::size_t path) {
+    return values[site * n_paths + path];
+  }
+  DataT operator()(std::size_t site, std::size_t path) const {
+    return values[site * n_paths + path];
+  }
+
+  // Values of all paths at `site`
+  DataT *site(std::size_t i) { return values.data() + i * n_paths; }
+  const DataT *site(std::size_t i) const { return values.data() + i * n_paths; }
+
+  DataT *data() { return values.data(); }
+  const DataT *data() const { return values.data(); }
+
+  template <typename PathType> void get_path(std::size_t path, PathType &res) const {
+    assert(res.size() == path_length);
+    for (std::size_t i = 0; i < path_length; ++i)
+      res[i] = (*this)(i, path);
+  }
+
+  template <typename PathType> void set_path(std::size_t path, const PathType &p) {
+    assert(p.size() == path_length);
+    for (std::size_t i = 0; i < path_length; ++i)
+      (*this)(i, path) = p[i];
+  }
+
+  void swap(path_ensemble &other) noexcept {
+    std::swap(path_length, other.path_length);
+    std::swap(n_paths, other.n_paths);
+    values.swap(other.values);
+  }
+
+private:
+  std::size_t path_length = 0;
+  std::size_t n_paths = 0;
+  std::vector<DataT> values;
+};
+
+} // namespace mlmcpi
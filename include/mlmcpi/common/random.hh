@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <span>
+#include <type_traits>
+
+namespace mlmcpi {
+
+/*
+  Counter-based random number engine Philox4x32-10 (Salmon et al., "Parallel random
+  numbers: as easy as 1, 2, 3", SC 2011). The n-th block of four 32 bit words is a
+  bijective function of the 128 bit counter (n, stream) and the 64 bit key (the seed),
+  so the engine has no state apart from its position:
+  - discard(n) skips ahead in O(1)
+  - split(stream) returns an independent engine for another stream of the same seed,
+    e.g., one per chain or per thread, also in O(1)
+  Every block yields two 64 bit outputs. The engine satisfies the requirements of a
+  uniform random bit generator and can be used with the standard distributions.
+  fill_normal() generates Gaussian samples in bulk directly from whole blocks.
+ */
+class philox_engine {
+public:
+  using result_type = std::uint64_t;
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+  explicit philox_engine(std::uint64_t seed_ = 0, std::uint64_t stream_ = 0)
+      : stream{stream_} {
+    seed(seed_);
+  }
+
+  template <typename SeedSeq>
+    requires(not std::is_convertible_v<SeedSeq, std::uint64_t>)
+  explicit philox_engine(SeedSeq &seq) {
+    std::array<std::uint32_t, 2> words;
+    seq.generate(words.begin(), words.end());
+    key = words;
+  }
+
+  void seed(std::uint64_t seed_) {
+    key = {static_cast<std::uint32_t>(seed_), static_cast<std::uint32_t>(seed_ >> 32)};
+    counter = 0;
+    half = 0;
+  }
+
+  result_type operator()() {
+    if (half == 0)
+      block = generate_block(counter);
+
+    const auto res = (static_cast<std::uint64_t>(block[2 * half + 1]) << 32) |
+                     static_cast<std::uint64_t>(block[2 * half]);
+
+    half ^= 1;
+    if (half == 0)
+      counter++;
+    return res;
+  }
+
+  void discard(unsigned long long n) {
+    const auto position = 2 * static_cast<std::uint64_t>(counter) + half + n;
+    counter = position / 2;
+    half = static_cast<unsigned>(position % 2);
+    if (half == 1)
+      block = generate_block(counter);
+  }
+
+  philox_engine split(std::uint64_t stream_) const {
+    philox_engine res(*this);
+    res.stream = stream_;
+    res.counter = 0;
+    res.half = 0;
+    return res;
+  }
+
+  /*
+    Fills `out` with standard normal samples, using Box-Muller on the two 53 bit uniforms
+    of every block. Starts at the next unused block and uses whole blocks only.
+   */
+  void fill_normal(std::span<double> out) {
+    if (half == 1) {
+      half = 0;
+      counter++;
+    }
+
+    constexpr std::size_t chunk = 128;
+    std::array<double, chunk> u1;
+    std::array<double, chunk> u2;
+
+    for (std::size_t begin = 0; begin < out.size(); begin += 2 * chunk) {
+      const auto n_pairs = std::min(chunk, (out.size() - begin + 1) / 2);
+
+      for (std::size_t i = 0; i < n_pairs; ++i) {
+        const auto b = generate_block(counter++);
+        u1[i] = to_open_unit_interval(b[0], b[1]);
+        u2[i] = to_open_unit_interval(b[2], b[3]);
+      }
+
+      for (std::size_t i = 0; i < n_pairs; ++i) {
+        const auto r = std::sqrt(-2 * std::log(u1[i]));
+        const auto theta = 2 * std::numbers::pi * u2[i];
+
+        out[begin + 2 * i] = r * std::cos(theta);
+        if (begin + 2 * i + 1 < out.size())
+          out[begin + 2 * i + 1] = r * std::sin(theta);
+      }
+    }
+  }
+
+  std::uint64_t get_stream() const { return stream; }
+
+  bool operator==(const philox_engine &other) const {
+    return key == other.key && stream == other.stream && counter == other.counter &&
+           half == other.half;
+  }
+
+  // The 4 x 32 bit block for counter (n, stream), exposed for known-answer tests
+  std::array<std::uint32_t, 4> generate_block(std::uint64_t n) const {
+    std::array<std::uint32_t, 4> ctr{
+        static_cast<std::uint32_t>(n), static_cast<std::uint32_t>(n >> 32),
+        static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+    auto k = key;
+
+    for (int round = 0; round < 10; ++round) {
+      if (round > 0) {
+        k[0] += 0x9E3779B9;
+        k[1] += 0xBB67AE85;
+      }
+
+      const auto p0 = static_cast<std::uint64_t>(0xD2511F53) * ctr[0];
+      const auto p1 = static_cast<std::uint64_t>(0xCD9E8D57) * ctr[2];
+
+      ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ k[0],
+             static_cast<std::uint32_t>(p1),
+             static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ k[1],
+             static_cast<std::uint32_t>(p0)};
+    }
+
+    return ctr;
+  }
+
+private:
+  // Uniform in (0, 1) from the upper 53 bits of a 64 bit word
+  static double to_open_unit_interval(std::uint32_t lo, std::uint32_t hi) {
+    const auto bits = ((static_cast<std::uint64_t>(hi) << 32) | lo) >> 11;
+    return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+  }
+
+  std::array<std::uint32_t, 2> key{};
+  std::uint64_t stream = 0;
+  std::uint64_t counter = 0;
+  unsigned half = 0;
+  std::array<std::uint32_t, 4> block{};
+};
+
+/*
+  Fills `out` with standard normal samples. Engines that provide a bulk fill_normal (such
+  as philox_engine) use it, all others fall back to Box-Muller on pairs of uniforms. Like
+  philox_engine::fill_normal, each call uses whole pairs only, so no cached variate is
+  carried over (or discarded) between calls.
+ */
+template <typename Engine> void fill_normal(Engine &engine, std::span<double> out) {
+  if constexpr (requires { engine.fill_normal(out); }) {
+    engine.fill_normal(out);
+  } else {
+    constexpr auto bits = std::numeric_limits<double>::digits;
+    for (std::size_t i = 0; i < out.size(); i += 2) {
+      // generate_canonical may round up to 1 (LWG 2524); u1 must be in (0, 1]
+      const auto c = std::generate_canonical<double, bits>(engine);
+      const auto u1 = 1. - std::min(c, 1. - std::numeric_limits<double>::epsilon() / 2);
+      const auto u2 = std::generate_canonical<double, bits>(engine);
+
+      const auto r = std::sqrt(-2 * std::log(u1));
+      const auto theta = 2 * std::numbers::pi * u2;
+
+      out[i] = r * std::cos(theta);
+      if (i + 1 < out.size())
+        out[i + 1] = r * std::sin(theta);
+    }
+  }
+}
+
+} // namespace mlmcpi
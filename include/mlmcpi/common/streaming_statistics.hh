@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Accumulates the statistics of a (possibly correlated) scalar time series in O(1)
+  memory and amortised O(1) time per sample.
+
+  Mean and variance are updated with Welford's algorithm. The error of the mean is
+  estimated with batch means: the series is cut into at most `max_batches` consecutive
+  batches; whenever all of them are filled, neighbouring batches are merged pairwise and
+  the batch size doubles. The batch size therefore grows with the length of the series
+  and eventually exceeds the autocorrelation time, which makes the batch means
+  (approximately) independent.
+
+  Until then, the variance of the batch means underestimates the error of the mean (with
+  a batch size of one, it ignores the autocorrelation altogether). mean_error() is
+  therefore infinite until the batches are at least `min_batch_size` long and
+  `min_batch_autocorr_times` times longer than the estimated autocorrelation time; the
+  relative bias of the error is then about 1 / (2 * min_batch_autocorr_times).
+ */
+template <typename DataT = double> class streaming_statistics {
+public:
+  static constexpr std::size_t min_batch_size = 16;
+  static constexpr std::size_t min_batch_autocorr_times = 8;
+
+  explicit streaming_statistics(std::size_t max_batches_ = 128)
+      : max_batches{max_batches_} {
+    assert(max_batches >= 4 && max_batches % 2 == 0);
+    batch_means.reserve(max_batches);
+  }
+
+  void add(const DataT &x) {
+    n++;
+
+    const auto delta = x - running_mean;
+    running_mean += delta / static_cast<DataT>(n);
+    m2 += delta * (x - running_mean);
+
+    batch_sum += x;
+    batch_fill++;
+    if (batch_fill == batch_size) {
+      batch_means.push_back(batch_sum / static_cast<DataT>(batch_size));
+      batch_sum = DataT{0};
+      batch_fill = 0;
+
+      if (batch_means.size() == max_batches)
+        merge_batches();
+    }
+  }
+
+  DataT mean() const { return running_mean; }
+
+  DataT variance() const {
+    if (n < 2)
+      return DataT{0};
+    return m2 / static_cast<DataT>(n - 1);
+  }
+
+  // Error of the mean, estimated from the variance of the completed batch means
+  DataT mean_error() const {
+    if (not batches_converged())
+      return std::numeric_limits<DataT>::infinity();
+
+    return std::sqrt(batch_variance() / static_cast<DataT>(batch_means.size()));
+  }
+
+  /*
+    Whether the batches are long enough compared with the autocorrelation time for their
+    means to be independent. The batch size only grows by merging all batches, so there
+    are at least max_batches / 2 of them once it exceeds one.
+   */
+  bool batches_converged() const {
+    if (batch_size < min_batch_size)
+      return false;
+
+    return static_cast<DataT>(batch_size) >=
+           static_cast<DataT>(min_batch_autocorr_times) * integrated_autocorr_time();
+  }
+
+  // Integrated autocorrelation time tau, defined such that mean_error^2 = tau * var / n
+  DataT integrated_autocorr_time() const {
+    const auto var = variance();
+    if (batch_means.size() < 2 || var <= 0)
+      return DataT{1};
+
+    return std::max(DataT{1}, static_cast<DataT>(batch_size) * batch_variance() / var);
+  }
+
+  std::size_t count() const { return n; }
+  std::size_t get_batch_size() const { return batch_size; }
+  std::size_t num_batches() const { return batch_means.size(); }
+
+  // The completed batch means; those of two series fed in lock-step are aligned
+  const std::vector<DataT> &get_batch_means() const { return batch_means; }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(max_batches, n, running_mean, m2, batch_means, batch_size,
+                     batch_fill, batch_sum);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(max_batches, n, running_mean, m2, batch_means, batch_size, batch_fill,
+                    batch_sum);
+  }
+
+private:
+  DataT batch_variance() const {
+    const auto n_batches = batch_means.size();
+
+    DataT m{0};
+    for (const auto &b : batch_means)
+      m += b;
+    m /= static_cast<DataT>(n_batches);
+
+    DataT sum_sq{0};
+    for (const auto &b : batch_means)
+      sum_sq += (b - m) * (b - m);
+    return sum_sq / static_cast<DataT>(n_batches - 1);
+  }
+
+  void merge_batches() {
+    const auto half = batch_means.size() / 2;
+    for (std::size_t i = 0; i < half; ++i)
+      batch_means[i] = 0.5 * (batch_means[2 * i] + batch_means[2 * i + 1]);
+    batch_means.resize(half);
+    batch_size *= 2;
+  }
+
+  std::size_t max_batches;
+
+  std::size_t n = 0;
+  DataT running_mean{0};
+  DataT m2{0};
+
+  std::vector<DataT> batch_means;
+  std::size_t batch_size = 1;
+  std::size_t batch_fill = 0;
+  DataT batch_sum{0};
+};
+
+} // namespace mlmcpi
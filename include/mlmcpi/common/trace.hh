@@ -0,0 +1,454 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MLMCPI_HAS_MMAP 1
+#else
+#define MLMCPI_HAS_MMAP 0
+#endif
+
+namespace mlmcpi {
+
+/*
+  Binary trace of a chain. The file starts with this header, followed by one record per
+  sample: `qoi_size` doubles with the QOI values and, for every `path_thinning`-th record
+  (starting with the first one), the `path_length` doubles of the current path. With
+  path_thinning = 0 no paths are stored. The number of records follows from the file
+  size, so a trace that was cut off (e.g., by a killed run) is still readable.
+
+  All values are stored in the native byte order; the header is 64 bytes long, so the
+  records are 8 byte aligned.
+ */
+struct trace_header {
+  static constexpr std::array<char, 8> trace_magic{'M', 'L', 'M', 'C',
+                                                   'P', 'I', 'T', 'R'};
+  static constexpr std::uint32_t trace_version = 1;
+
+  std::array<char, 8> magic = trace_magic;
+  std::uint32_t version = trace_version;
+  std::uint32_t header_size = 64;
+
+  std::uint64_t path_length = 0; // N, the number of sites on the finest level
+  std::uint64_t levels = 1;
+  double delta_t = 0; // Lattice spacing on the finest level
+  std::uint64_t seed = 0;
+
+  std::uint64_t qoi_size = 1;
+  std::uint64_t path_thinning = 0;
+
+  // Offset of record i after the header, in doubles; records with paths are followed by
+  // the path
+  std::size_t record_offset(std::size_t i) const {
+    if (path_thinning == 0)
+      return i * qoi_size;
+
+    const auto n_paths = (i + path_thinning - 1) / path_thinning;
+    return i * qoi_size + n_paths * path_length;
+  }
+
+  // Number of complete records in `n_values` doubles; the last one may have been cut off
+  std::size_t complete_records(std::size_t n_values) const {
+    if (path_thinning == 0)
+      return n_values / qoi_size;
+
+    const auto block = path_thinning * qoi_size + path_length;
+    auto n_records = n_values / block * path_thinning;
+
+    const auto rest = n_values % block;
+    if (rest >= qoi_size + path_length)
+      n_records += 1 + (rest - qoi_size - path_length) / qoi_size;
+    return n_records;
+  }
+
+  // Whether records written with `other` can be appended to a trace with this header
+  bool same_layout(const trace_header &other) const {
+    return magic == other.magic && version == other.version &&
+           header_size == other.header_size && path_length == other.path_length &&
+           levels == other.levels && delta_t == other.delta_t &&
+           qoi_size == other.qoi_size && path_thinning == other.path_thinning;
+  }
+};
+static_assert(sizeof(trace_header) == 64 && std::is_trivially_copyable_v<trace_header>);
+
+/*
+  Appends records to a trace file (see trace_header). Records are collected in a buffer
+  of `buffer_size` doubles; when it is full it is handed to a background thread, which
+  writes it to disk while the chain continues to fill a second buffer. The chain only
+  waits if it fills a buffer faster than the disk can take the previous one.
+
+  Write errors are reported by good() and close(), which has to be called (or is called
+  by the destructor) to write out the last records.
+
+  With trace_mode::resume, an existing trace with the same layout is kept, including its
+  header (and thus the seed of the run that started it), and new records are appended
+  after its complete records. This is meant for runs that continue from a checkpoint,
+  which truncate the trace to the records written up to the checkpoint (see
+  single_level_mcmc::enable_trace) or restart it if there is nothing to continue.
+ */
+enum class trace_mode { create, resume };
+
+class trace_writer {
+public:
+  trace_writer(const std::string &filename_, const trace_header &header_,
+               trace_mode mode = trace_mode::create,
+               std::size_t buffer_size_ = std::size_t{1} << 20)
+      : filename{filename_},
+        header{header_},
+        requested_header{header_},
+        buffer_size{buffer_size_} {
+    assert(header.qoi_size > 0);
+    assert(header.path_thinning == 0 || header.path_length > 0);
+
+    if (mode == trace_mode::resume)
+      resume_file();
+    if (file == nullptr)
+      create_file();
+
+    front.reserve(buffer_size);
+    back.reserve(buffer_size);
+    thread = std::thread([this]() { write_loop(); });
+  }
+
+  trace_writer(const trace_writer &) = delete;
+  trace_writer &operator=(const trace_writer &) = delete;
+
+  ~trace_writer() { close(); }
+
+  /*
+    Appends a record with the QOI value(s) `qoi` (a number or a contiguous container of
+    qoi_size numbers) and, if this record is due for one, the current `path`.
+   */
+  template <typename QOIValue, typename PathType>
+  void add(const QOIValue &qoi, const PathType &path) {
+    if constexpr (std::is_arithmetic_v<QOIValue>) {
+      assert(header.qoi_size == 1);
+      front.push_back(static_cast<double>(qoi));
+    } else {
+      assert(qoi.size() == header.qoi_size);
+      front.insert(front.end(), qoi.data(), qoi.data() + qoi.size());
+    }
+
+    if (header.path_thinning > 0 && n_records % header.path_thinning == 0) {
+      assert(path.size() == header.path_length);
+      for (std::size_t i = 0; i < path.size(); ++i)
+        front.push_back(path[i]);
+    }
+
+    n_records++;
+    if (front.size() >= buffer_size)
+      hand_over();
+  }
+
+  // Writes out all records added so far and flushes them to disk
+  bool flush() {
+    if (not thread.joinable())
+      return ok;
+
+    if (not front.empty())
+      hand_over();
+    wait_until_written();
+
+    if (file != nullptr) {
+      ok = std::fflush(file) == 0 && ok;
+#if MLMCPI_HAS_MMAP
+      ok = ::fsync(::fileno(file)) == 0 && ok;
+#endif
+    }
+    return ok;
+  }
+
+  /*
+    Drops all records after the first `n_records_`, which have to be written already.
+    Returns false if the trace is shorter or cannot be truncated.
+   */
+  bool truncate(std::size_t n_records_) {
+    if (not flush() || n_records_ > n_records)
+      return false;
+
+    resize_file(n_records_);
+    return ok;
+  }
+
+  // Drops all records and writes the header the writer was constructed with
+  bool restart() {
+    if (not thread.joinable())
+      return ok;
+
+    front.clear();
+    wait_until_written();
+
+    if (file != nullptr)
+      std::fclose(file);
+    header = requested_header;
+    n_records = 0;
+    create_file();
+    return ok;
+  }
+
+  // Writes out all records and closes the file. Returns false if any write failed.
+  bool close() {
+    if (not thread.joinable())
+      return ok;
+
+    if (not front.empty())
+      hand_over();
+
+    {
+      std::lock_guard lock(mutex);
+      closing = true;
+    }
+    cv.notify_all();
+    thread.join();
+
+    if (file != nullptr) {
+      ok = std::fclose(file) == 0 && ok;
+      file = nullptr;
+    }
+    return ok;
+  }
+
+  bool good() const { return ok; }
+  std::size_t num_records() const { return n_records; }
+  const trace_header &get_header() const { return header; }
+
+private:
+  void create_file() {
+    file = std::fopen(filename.c_str(), "wb");
+    ok = file != nullptr && std::fwrite(&header, sizeof(header), 1, file) == 1;
+  }
+
+  // Opens an existing trace with the same layout for appending; leaves file == nullptr
+  // if there is none
+  void resume_file() {
+    std::FILE *existing = std::fopen(filename.c_str(), "r+b");
+    if (existing == nullptr)
+      return;
+
+    trace_header existing_header;
+    std::error_code error;
+    const auto size = std::filesystem::file_size(filename, error);
+    if (error || size < sizeof(trace_header) ||
+        std::fread(&existing_header, sizeof(trace_header), 1, existing) != 1 ||
+        not existing_header.same_layout(header)) {
+      std::fclose(existing);
+      return;
+    }
+
+    header = existing_header;
+    file = existing;
+
+    // Cuts off an incomplete last record
+    ok = true;
+    resize_file(header.complete_records((size - sizeof(trace_header)) / sizeof(double)));
+  }
+
+  // Resizes the file to the header and the first `n_records_` records
+  void resize_file(std::size_t n_records_) {
+    n_records = n_records_;
+    const auto size =
+        sizeof(trace_header) + sizeof(double) * header.record_offset(n_records);
+
+    std::error_code error;
+    std::filesystem::resize_file(filename, size, error);
+    ok = not error && std::fseek(file, 0, SEEK_END) == 0 && ok;
+  }
+
+  void wait_until_written() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [this]() { return not pending; });
+  }
+
+  // Waits until the background thread is done with the back buffer, then swaps buffers
+  void hand_over() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [this]() { return not pending; });
+    std::swap(front, back);
+    front.clear();
+    pending = true;
+    lock.unlock();
+    cv.notify_all();
+  }
+
+  void write_loop() {
+    std::unique_lock lock(mutex);
+    while (true) {
+      cv.wait(lock, [this]() { return pending || closing; });
+      if (not pending)
+        return;
+
+      // The chain does not touch the back buffer while it is pending
+      lock.unlock();
+      if (ok) {
+        const auto n = back.size();
+        ok = std::fwrite(back.data(), sizeof(double), n, file) == n;
+      }
+      lock.lock();
+
+      pending = false;
+      cv.notify_all();
+    }
+  }
+
+  std::string filename;
+  trace_header header;
+  trace_header requested_header;
+  std::size_t buffer_size;
+  std::size_t n_records = 0;
+
+  std::FILE *file = nullptr;
+  std::atomic<bool> ok = false;
+
+  std::vector<double> front; // Filled by the chain
+  std::vector<double> back;  // Written by the background thread
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool pending = false;
+  bool closing = false;
+  std::thread thread;
+};
+
+/*
+  Read-only view of a trace file. The file is memory-mapped (where available), so
+  records are accessed in place without reading the whole file first, and the pages of
+  traces larger than the main memory are loaded on demand.
+ */
+class trace_reader {
+public:
+  // Returns an empty optional if the file cannot be opened or is not a trace
+  static std::optional<trace_reader> open(const std::string &filename) {
+    trace_reader reader;
+    if (not reader.map(filename) || reader.size < sizeof(trace_header))
+      return {};
+
+    std::memcpy(&reader.header, reader.data, sizeof(trace_header));
+    if (reader.header.magic != trace_header::trace_magic ||
+        reader.header.version != trace_header::trace_version ||
+        reader.header.header_size != sizeof(trace_header) || reader.header.qoi_size == 0)
+      return {};
+
+    reader.records = reinterpret_cast<const double *>(reader.data + sizeof(trace_header));
+    const auto n_values = (reader.size - sizeof(trace_header)) / sizeof(double);
+    reader.n_records = reader.header.complete_records(n_values);
+    return reader;
+  }
+
+  trace_reader(trace_reader &&other) noexcept { *this = std::move(other); }
+
+  trace_reader &operator=(trace_reader &&other) noexcept {
+    std::swap(header, other.header);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(records, other.records);
+    std::swap(n_records, other.n_records);
+    std::swap(buffer, other.buffer);
+    return *this;
+  }
+
+  ~trace_reader() { unmap(); }
+
+  const trace_header &get_header() const { return header; }
+  std::size_t num_records() const { return n_records; }
+
+  std::span<const double> qoi(std::size_t i) const {
+    assert(i < n_records);
+    return {records + header.record_offset(i), header.qoi_size};
+  }
+
+  bool has_path(std::size_t i) const {
+    return header.path_thinning > 0 && i % header.path_thinning == 0;
+  }
+
+  std::span<const double> path(std::size_t i) const {
+    assert(i < n_records && has_path(i));
+    return {records + header.record_offset(i) + header.qoi_size, header.path_length};
+  }
+
+private:
+  trace_reader() = default;
+
+  bool map(const std::string &filename) {
+#if MLMCPI_HAS_MMAP
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+
+    size = static_cast<std::size_t>(info.st_size);
+    void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      size = 0;
+      return false;
+    }
+
+    data = static_cast<const char *>(mapping);
+    return true;
+#else
+    // Without mmap, the whole file is read into memory
+    std::FILE *file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+      return false;
+
+    std::vector<char> contents;
+    std::array<char, 4096> chunk;
+    std::size_t n_read = 0;
+    while ((n_read = std::fread(chunk.data(), 1, chunk.size(), file)) > 0)
+      contents.insert(contents.end(), chunk.data(), chunk.data() + n_read);
+    std::fclose(file);
+
+    size = contents.size();
+    buffer.resize((size + sizeof(double) - 1) / sizeof(double));
+    std::memcpy(buffer.data(), contents.data(), size);
+    data = reinterpret_cast<const char *>(buffer.data());
+    return true;
+#endif
+  }
+
+  void unmap() {
+#if MLMCPI_HAS_MMAP
+    if (data != nullptr)
+      ::munmap(const_cast<char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+  }
+
+  trace_header header;
+  const char *data = nullptr;
+  std::size_t size = 0;
+
+  const double *records = nullptr;
+  std::size_t n_records = 0;
+
+  // Only used without mmap; doubles, so the records are aligned
+  std::vector<double> buffer;
+};
+
+} // namespace mlmcpi
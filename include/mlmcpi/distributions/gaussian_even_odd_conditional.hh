@@ -1,12 +1,16 @@
 #pragma once
 
 #include "mlmcpi/common/partition.hh"
+#include "mlmcpi/common/path_ensemble.hh"
+#include "mlmcpi/common/random.hh"
 
 #include <cassert>
 #include <cmath>
 #include <iostream>
 #include <memory>
 #include <random>
+#include <span>
+#include <vector>
 
 namespace mlmcpi {
 template <typename Action, typename Engine = std::mt19937>
@@ -21,14 +25,16 @@ public:
   PathType sample(const PathType &even_points) {
     assert(2 * even_points.size() == action.get_path_length());
 
+    // Draw all standard normal samples at once and shift and scale them in place
     PathType odd_points(even_points.size());
+    fill_normal(engine, std::span<double>{odd_points.data(), odd_points.size()});
 
     for (std::size_t i = 0; i < even_points.size() - 1; ++i) {
       const auto x_m = even_points[i];
       const auto x_p = even_points[i + 1];
       const auto x_min = action.W_minimum(x_m, x_p);
       const auto sigma = 1. / std::sqrt(action.W_curvature(x_m, x_p));
-      odd_points[i] = x_min + normal_dist(engine) * sigma;
+      odd_points[i] = x_min + odd_points[i] * sigma;
     }
 
     // Treat final point using periodic BC's
@@ -37,12 +43,33 @@ public:
     const auto x_min = action.W_minimum(x_m, x_p);
     const auto sigma = 1. / std::sqrt(action.W_curvature(x_m, x_p));
 
-    odd_points[even_points.size() - 1] = x_min + normal_dist(engine) * sigma;
+    odd_points[even_points.size() - 1] =
+        x_min + odd_points[even_points.size() - 1] * sigma;
 
     return odd_points;
   }
 
-  double log_density(const PathType &path) const {
+  /*
+    Same as sample, but reads the even sites of `path` and overwrites its odd sites in
+    place. `path` may be a path or a view of one (see partition.hh).
+   */
+  template <typename Vector> void sample_odd_sites(Vector &&path) {
+    assert(path.size() == action.get_path_length());
+    const auto size = path.size();
+
+    noise.resize(size / 2);
+    fill_normal(engine, std::span<double>{noise});
+
+    for (std::size_t i = 1; i < size; i += 2) {
+      const auto x_m = path[i - 1];
+      const auto x_p = path[(i + 1) % size];
+      const auto x_min = action.W_minimum(x_m, x_p);
+      const auto sigma = 1. / std::sqrt(action.W_curvature(x_m, x_p));
+      path[i] = x_min + noise[i / 2] * sigma;
+    }
+  }
+
+  template <typename Vector> double log_density(const Vector &path) const {
     assert(path.size() == action.get_path_length());
     const auto size = path.size();
 
@@ -63,11 +90,56 @@ public:
     return S;
   }
 
+  // Batched versions of sample_odd_sites and log_density, see path_ensemble.hh
+  void sample_odd_sites_batch(path_ensemble<double> &paths) {
+    assert(paths.get_path_length() == action.get_path_length());
+    const auto size = paths.get_path_length();
+    const auto n_paths = paths.num_paths();
+
+    noise.resize(size / 2 * n_paths);
+    fill_normal(engine, std::span<double>{noise});
+
+    for (std::size_t i = 1; i < size; i += 2) {
+      const double *__restrict x_m = paths.site(i - 1);
+      const double *__restrict x_p = paths.site((i + 1) % size);
+      const double *__restrict xi = noise.data() + i / 2 * n_paths;
+      double *__restrict x = paths.site(i);
+
+      for (std::size_t k = 0; k < n_paths; ++k) {
+        const auto x_min = action.W_minimum(x_m[k], x_p[k]);
+        const auto sigma = 1. / std::sqrt(action.W_curvature(x_m[k], x_p[k]));
+        x[k] = x_min + xi[k] * sigma;
+      }
+    }
+  }
+
+  void log_density_batch(const path_ensemble<double> &paths,
+                         std::vector<double> &res) const {
+    assert(paths.get_path_length() == action.get_path_length());
+    const auto size = paths.get_path_length();
+    const auto n_paths = paths.num_paths();
+    res.assign(n_paths, 0.);
+
+    double *__restrict r = res.data();
+    for (std::size_t i = 1; i < size; i += 2) {
+      const double *__restrict x_m = paths.site(i - 1);
+      const double *__restrict x_p = paths.site((i + 1) % size);
+      const double *__restrict x = paths.site(i);
+
+      for (std::size_t k = 0; k < n_paths; ++k) {
+        const auto dx = x[k] - action.W_minimum(x_m[k], x_p[k]);
+        const auto curvature = action.W_curvature(x_m[k], x_p[k]);
+        r[k] += 0.5 * curvature * dx * dx - 0.5 * std::log(curvature);
+      }
+    }
+  }
+
 private:
   const Action &action;
   Engine &engine;
 
-  std::normal_distribution<double> normal_dist;
+  // Standard normal samples for the in-place and batched versions
+  std::vector<double> noise;
 };
 
 } // namespace mlmcpi
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "mlmcpi/common/multilevel_result.hh"
+#include "mlmcpi/common/partition.hh"
+#include "mlmcpi/qoi/identity.hh"
+#include "mlmcpi/samplers/sampler.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Multilevel Monte Carlo estimator E[Q_L] = E[Q_0] + sum_{l=1}^{L-1} E[Q_l - Q_{l-1}].
+
+  Level 0 is sampled with a single-level sampler, the corrections with coupled samplers
+  (see coupled_level_sampler.hh), one per level from the coarsest to the finest. All
+  levels first perform `n_burnin` steps and then a pilot run of `n_pilot` steps, which
+  provides the variance V_l (including the autocorrelation, i.e., N_l times the squared
+  error of the mean) and the cost C_l (wall clock time) per sample of every level. For a
+  total error eps, the cost is minimised by
+
+    N_l = eps^{-2} sqrt(V_l / C_l) sum_k sqrt(V_k C_k).
+
+  The levels are extended to these numbers of samples, after which V_l and C_l are
+  re-estimated until the error is below `target_error` or every level has performed
+  `max_steps` steps. Only the statistical error is controlled; the bias E[Q - Q_L] is
+  determined by the finest level.
+ */
+template <typename CoarsestSampler, typename... CoupledSamplers> class multilevel_mcmc {
+public:
+  using PathType = typename CoarsestSampler::PathType;
+
+  static constexpr std::size_t n_levels = 1 + sizeof...(CoupledSamplers);
+
+  static_assert(not coupled_sampler<CoarsestSampler>,
+                "The coarsest level has to be sampled by a single-level sampler");
+  static_assert((coupled_sampler<CoupledSamplers> && ...),
+                "The corrections have to be sampled by coupled samplers");
+
+  multilevel_mcmc(CoarsestSampler &coarsest_sampler, CoupledSamplers &...coupled_samplers)
+      : samplers{coarsest_sampler, coupled_samplers...} {}
+
+  /*
+    `initial_path` is a path on the finest level; the initial states on the coarser levels
+    are obtained by restricting it to every second, fourth, ... site.
+   */
+  template <typename QOI = mlmcpi::identity<PathType>>
+  multilevel_result<typename QOI::ResultType>
+  run(std::size_t n_burnin, const PathType &initial_path, double target_error = 1e-2,
+      std::size_t max_steps = 1000000) {
+    QOI qoi;
+    multilevel_result<typename QOI::ResultType> result(n_levels);
+    std::vector<double> elapsed(n_levels, 0.);
+
+    auto states = make_states(initial_path, std::make_index_sequence<n_levels>{});
+    coarsest_workspace = std::get<0>(states);
+
+    const auto burnin = [&](auto &sampler, auto &state, std::size_t) {
+      using Sampler = std::remove_cvref_t<decltype(sampler)>;
+
+      // Adaptive samplers tune their parameters during the burn-in
+      if constexpr (adaptive_sampler<Sampler>)
+        if (adapt_during_burnin)
+          sampler.start_adaptation(n_burnin);
+
+      for (std::size_t i = 0; i < n_burnin; ++i)
+        step(sampler, state);
+
+      if constexpr (adaptive_sampler<Sampler>)
+        sampler.stop_adaptation();
+    };
+
+    std::vector<std::size_t> n_steps(n_levels, std::min(n_pilot, max_steps));
+    const auto sample = [&](auto &sampler, auto &state, std::size_t level) {
+      using Sampler = std::remove_cvref_t<decltype(sampler)>;
+
+      const auto start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < n_steps[level]; ++i) {
+        const bool accepted = step(sampler, state);
+
+        if constexpr (coupled_sampler<Sampler>)
+          result.levels[level].add_sample(qoi(state.path) - qoi(state.coarse.path),
+                                          accepted);
+        else
+          result.levels[level].add_sample(qoi(state.path), accepted);
+      }
+      const std::chrono::duration<double> duration =
+          std::chrono::steady_clock::now() - start;
+      elapsed[level] += duration.count();
+    };
+
+    for (std::size_t level = 0; level < n_levels; ++level)
+      visit_level(level, states, burnin);
+
+    // Pilot run, followed by runs with the optimal number of samples on each level
+    while (true) {
+      for (std::size_t level = 0; level < n_levels; ++level)
+        visit_level(level, states, sample);
+
+      const auto error = result.mean_error();
+      if (error < target_error)
+        break;
+
+      std::vector<double> variances(n_levels);
+      std::vector<double> costs(n_levels);
+      double sum = 0;
+      for (std::size_t l = 0; l < n_levels; ++l) {
+        const auto n = static_cast<double>(result.levels[l].num_samples());
+        const auto err = result.levels[l].mean_error();
+
+        variances[l] = err * err * n;
+        costs[l] = elapsed[l] / n;
+        if (std::isfinite(variances[l]))
+          sum += std::sqrt(variances[l] * costs[l]);
+      }
+
+      bool any_level_extended = false;
+      for (std::size_t l = 0; l < n_levels; ++l) {
+        const auto n = result.levels[l].num_samples();
+
+        double required = 2. * static_cast<double>(n); // error not yet available
+        if (std::isfinite(variances[l]) && costs[l] > 0)
+          required = std::sqrt(variances[l] / costs[l]) * sum /
+                     (target_error * target_error);
+
+        const auto n_required = static_cast<std::size_t>(
+            std::min(std::ceil(required), static_cast<double>(max_steps)));
+        n_steps[l] = n_required > n ? n_required - n : 0;
+        any_level_extended = any_level_extended || n_steps[l] > 0;
+      }
+
+      // The allocation is already met but the estimates have changed since it was
+      // computed; extend all levels by the missing factor
+      if (not any_level_extended) {
+        const auto ratio = error / target_error;
+        const auto factor = std::isfinite(ratio) ? ratio * ratio : 2.;
+        for (std::size_t l = 0; l < n_levels; ++l) {
+          const auto n = result.levels[l].num_samples();
+          const auto required = std::ceil(factor * static_cast<double>(n));
+          const auto n_required = static_cast<std::size_t>(
+              std::min(required, static_cast<double>(max_steps)));
+          n_steps[l] = n_required > n ? n_required - n : 0;
+          any_level_extended = any_level_extended || n_steps[l] > 0;
+        }
+      }
+
+      if (not any_level_extended)
+        break; // All levels have reached max_steps
+    }
+
+    for (std::size_t l = 0; l < n_levels; ++l)
+      result.cost_per_sample[l] =
+          elapsed[l] / static_cast<double>(result.levels[l].num_samples());
+
+    return result;
+  }
+
+  // Number of steps of the pilot run on each level
+  std::size_t n_pilot = 1000;
+
+  bool adapt_during_burnin = true;
+
+private:
+  using States = std::tuple<typename CoarsestSampler::State,
+                            typename CoupledSamplers::State...>;
+
+  template <std::size_t... I>
+  States make_states(const PathType &finest_path, std::index_sequence<I...>) {
+    return States{std::get<I>(samplers).make_state(restrict_to_level(finest_path, I))...};
+  }
+
+  PathType restrict_to_level(const PathType &finest_path, std::size_t level) const {
+    const auto stride = std::size_t{1} << (n_levels - 1 - level);
+
+    PathType path(finest_path.size() / stride);
+    assign_sites(sub_lattice(finest_path, stride), path);
+    return path;
+  }
+
+  // Calls f(sampler, state, level) for the sampler and state on `level`
+  template <std::size_t I = 0, typename F>
+  void visit_level(std::size_t level, States &states, F &&f) {
+    if constexpr (I < n_levels) {
+      if (level == I)
+        f(std::get<I>(samplers), std::get<I>(states), level);
+      else
+        visit_level<I + 1>(level, states, std::forward<F>(f));
+    }
+  }
+
+  // Advances the chain(s) of `sampler` by one step and returns if the step was accepted
+  template <typename Sampler, typename State>
+  bool step(Sampler &sampler, State &state) {
+    if constexpr (coupled_sampler<Sampler>)
+      return sampler.advance(state);
+    else
+      return sampler.step(state, coarsest_workspace);
+  }
+
+  std::tuple<CoarsestSampler &, CoupledSamplers &...> samplers;
+
+  // Only the coarsest sampler needs a workspace, the coupled samplers own theirs
+  typename CoarsestSampler::State coarsest_workspace;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "mlmcpi/common/multi_chain_result.hh"
+#include "mlmcpi/samplers/sampler.hh"
+
+#include <algorithm>
+#include <barrier>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Runs several independent Markov chains on a pool of threads.
+
+  The chain factory is called once per chain as `factory(chain_index, engine)` and has to
+  return a self-contained chain, i.e., an object providing `make_state(path)` and
+  `step(state, workspace)` (see sampler.hh) that owns (copies of) everything it needs
+  apart from the engine. This can be any of the samplers, wrapped in a struct that also
+  holds the actions (and coarse samplers, conditionals, ...) they refer to. The chain is
+  constructed in place, so it may hold references to its own members. Chains that are
+  adaptive samplers (see sampler.hh) are tuned during the burn-in.
+
+  Every chain gets its own engine: counter-based engines (see random.hh) are split into
+  one stream per chain, all others are seeded from `seed` and the chain index. The chains
+  advance in rounds of `check_interval` steps, after which the combined error and the
+  Gelman-Rubin R-hat are checked. Since the rounds are synchronised, the result is
+  reproducible and independent of the number of threads.
+ */
+template <typename ChainFactory, typename Engine = std::mt19937_64> class parallel_mcmc {
+public:
+  using Chain = std::invoke_result_t<ChainFactory &, std::size_t, Engine &>;
+
+  parallel_mcmc(ChainFactory factory_, std::size_t n_chains_, std::uint64_t seed_,
+                std::size_t n_threads_ = std::thread::hardware_concurrency())
+      : factory{std::move(factory_)},
+        n_chains{n_chains_},
+        n_threads{std::clamp<std::size_t>(n_threads_, 1, n_chains_)},
+        seed{seed_} {}
+
+  /*
+    Runs all chains until the error of the combined estimate is below `target_error` and
+    R-hat is below `max_r_hat`, or until every chain has performed `max_steps` steps.
+   */
+  template <typename QOI, typename PathType>
+  multi_chain_result<typename QOI::ResultType>
+  run(std::size_t n_burnin, const PathType &initial_path, double target_error = 1e-2,
+      std::size_t max_steps = 1000000, double max_r_hat = 1.05) {
+    multi_chain_result<typename QOI::ResultType> result(n_chains);
+
+    std::vector<Engine> engines;
+    engines.reserve(n_chains);
+    for (std::size_t c = 0; c < n_chains; ++c) {
+      if constexpr (requires(const Engine &e) { e.split(c); }) {
+        engines.push_back(Engine(seed).split(c));
+      } else {
+        std::seed_seq seq{static_cast<std::uint32_t>(seed),
+                          static_cast<std::uint32_t>(seed >> 32),
+                          static_cast<std::uint32_t>(c)};
+        engines.emplace_back(seq);
+      }
+    }
+
+    std::vector<std::unique_ptr<Chain>> chains(n_chains);
+    for (std::size_t c = 0; c < n_chains; ++c)
+      chains[c].reset(new Chain(factory(c, engines[c])));
+
+    using State = decltype(chains[0]->make_state(initial_path));
+    std::vector<State> states;
+    states.reserve(n_chains);
+    for (std::size_t c = 0; c < n_chains; ++c)
+      states.push_back(chains[c]->make_state(initial_path));
+    auto workspaces = states;
+
+    std::size_t steps = 0;
+    std::size_t round_steps = std::min(check_interval, max_steps);
+    bool done = (max_steps == 0);
+
+    const auto on_round_completion = [&]() noexcept {
+      steps += round_steps;
+
+      const auto error = result.mean_error();
+      const bool converged =
+          error < target_error && error > 1e-12 && result.r_hat() < max_r_hat;
+
+      done = converged || steps >= max_steps;
+      round_steps = std::min(check_interval, max_steps - steps);
+    };
+    std::barrier sync(static_cast<std::ptrdiff_t>(n_threads), on_round_completion);
+
+    const auto worker = [&](std::size_t thread_id) {
+      QOI qoi;
+
+      for (std::size_t c = thread_id; c < n_chains; c += n_threads) {
+        if constexpr (adaptive_sampler<Chain>)
+          chains[c]->start_adaptation(n_burnin);
+
+        run_steps(*chains[c], states[c], workspaces[c], n_burnin);
+
+        if constexpr (adaptive_sampler<Chain>)
+          chains[c]->stop_adaptation();
+      }
+
+      while (not done) {
+        for (std::size_t c = thread_id; c < n_chains; c += n_threads) {
+          for (std::size_t i = 0; i < round_steps; ++i) {
+            const bool accepted = chains[c]->step(states[c], workspaces[c]);
+            result.chains[c].add_sample(qoi(states[c].path), accepted);
+          }
+        }
+
+        sync.arrive_and_wait();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads);
+    for (std::size_t t = 0; t < n_threads; ++t)
+      threads.emplace_back(worker, t);
+    for (auto &thread : threads)
+      thread.join();
+
+    return result;
+  }
+
+  std::size_t get_num_chains() const { return n_chains; }
+  std::size_t get_num_threads() const { return n_threads; }
+
+  // Number of steps every chain performs between two convergence checks
+  std::size_t check_interval = 100;
+
+private:
+  ChainFactory factory;
+
+  std::size_t n_chains;
+  std::size_t n_threads;
+  std::uint64_t seed;
+};
+
+} // namespace mlmcpi
@@ -1,20 +1,28 @@
 #pragma once
 
+#include "mlmcpi/common/checkpoint.hh"
 #include "mlmcpi/common/mcmc_result.hh"
 #include "mlmcpi/common/sample_result.hh"
+#include "mlmcpi/common/trace.hh"
 #include "mlmcpi/qoi/identity.hh"
+#include "mlmcpi/samplers/sampler.hh"
 
+#include <algorithm>
+#include <bit>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <random>
+#include <string>
+#include <typeinfo>
 #include <utility>
 #include <vector>
 
 namespace mlmcpi {
 
-template <typename Sampler> struct single_level_mcmc {
+template <mcmc_sampler Sampler> struct single_level_mcmc {
   using PathType = typename Sampler::PathType;
 
   single_level_mcmc(Sampler &sampler_) : sampler{sampler_} {}
@@ -22,53 +30,297 @@ template <typename Sampler> struct single_level_mcmc {
   template <typename QOI = mlmcpi::identity<PathType>>
   mcmc_result<typename QOI::ResultType> run(std::size_t n_burnin, PathType initial_path,
                                             double target_error = 1e-2,
-                                            std::size_t max_steps = 1000000) {
+                                            std::size_t max_steps = 1000000,
+                                            bool keep_samples = false) {
     QOI qoi;
-    mcmc_result<typename QOI::ResultType> result;
+    mcmc_result<typename QOI::ResultType> result(keep_samples);
 
-    auto current = initial_path;
-    for (std::size_t i = 0; i < n_burnin; ++i) {
-      const auto proposal = sampler.perform_step(current);
-      current = proposal.value_or(current);
+    std::size_t n_components = 1;
+    if constexpr (vector_valued<typename QOI::ResultType>)
+      n_components = qoi(initial_path).size();
+
+    // A checkpoint is only resumed from by a run with the same fingerprint
+    binary_writer fingerprint_writer;
+    fingerprint_writer.write_all(n_burnin, target_error, max_steps, keep_samples,
+                                 std::string(typeid(QOI).name()), n_components,
+                                 run_parameters);
+    fingerprint = fingerprint_writer.get_buffer();
+
+    std::size_t step = 1;
+    std::size_t required_steps = std::numeric_limits<std::size_t>::max();
+
+    // Steps (and accepted steps) since the last measurement of the QOI
+    measurement_counters counters;
+
+    // The state caches the action of the current path, so it is only evaluated for the
+    // proposals, which are assembled in the workspace
+    auto current = sampler.make_state(initial_path);
+    auto workspace = current;
+
+    if (not load_checkpoint(current, workspace, result, step, required_steps, counters)) {
+      // Records of an earlier run that did not reach a checkpoint are dropped
+      if (trace != nullptr)
+        trace->restart();
+
+      // Adaptive samplers tune their parameters during the burn-in
+      if constexpr (adaptive_sampler<Sampler>)
+        if (adapt_during_burnin)
+          sampler.start_adaptation(n_burnin);
+
+      run_steps(sampler, current, workspace, n_burnin);
+
+      if constexpr (adaptive_sampler<Sampler>)
+        sampler.stop_adaptation();
+
+      save_checkpoint(current, result, step, required_steps, counters);
     }
 
-    const auto compute_required_samples = [&]() {
-      const auto autocorr_time = result.integrated_autocorr_time();
-      const auto var = result.variance();
+    /*
+      Since mean_error^2 = tau * var / n, the number of measurements needed to reach the
+      target error is n * (mean_error / target_error)^2. As long as the measurements are
+      at most about tau_steps / 4 apart, the error depends on the number of steps rather
+      than on the number of measurements, so the required number of steps is extrapolated
+      in the same way.
+     */
+    const auto compute_required_steps = [&]() {
+      const auto error = result.max_mean_error();
 
-      if (autocorr_time == 0)
+      if (not std::isfinite(error))
         return std::numeric_limits<std::size_t>::max();
 
-      return static_cast<std::size_t>(
-          std::ceil((autocorr_time * var) / (target_error * target_error)));
+      const auto ratio = error / target_error;
+      return static_cast<std::size_t>(std::ceil(result.num_steps() * ratio * ratio));
     };
 
-    std::size_t step = 1;
-    std::size_t required_samples = std::numeric_limits<std::size_t>::max();
+    while (step <= required_steps && step <= max_steps) {
+      const bool accepted = sampler.step(current, workspace);
+      counters.steps++;
+      if (accepted)
+        counters.accepted++;
 
-    while (step <= required_samples && step <= max_steps) {
-      const auto proposal = sampler.perform_step(current);
-      current = proposal.value_or(current);
+      if (counters.steps >= measurement_interval) {
+        const auto &value = qoi(current.path);
+        result.add_sample(value, counters.steps, counters.accepted);
+        if (trace != nullptr)
+          trace->add(value, current.path);
+        counters = {};
 
-      result.add_sample(qoi(std::forward<PathType>(current)), proposal.has_value());
+        // Check if we have enough samples for the required error every 100 measurements
+        const auto n_measurements = result.num_samples();
+        if (n_measurements % 100 == 0) {
+          required_steps = compute_required_steps();
 
-      // Check if we have enough samples for the required error every 100 steps
-      if (step % 100 == 0) {
-        required_samples = compute_required_samples();
+          if (result.max_mean_error() < 1e-12)
+            required_steps = std::numeric_limits<std::size_t>::max();
 
-        if (result.mean_error() < 1e-12)
-          required_samples = std::numeric_limits<std::size_t>::max();
+          if (adapt_measurement_interval && std::has_single_bit(n_measurements / 100))
+            update_measurement_interval(result);
+        }
       }
 
       step++;
+
+      if (checkpoint_interval > 0 && (step - 1) % checkpoint_interval == 0)
+        save_checkpoint(current, result, step, required_steps, counters);
     }
 
+    save_checkpoint(current, result, step, required_steps, counters);
+
     return result;
   }
 
+  /*
+    Makes run() write a checkpoint (see checkpoint.hh) to `path` after the burn-in, every
+    `interval` steps and at the end. It contains the current path, the parameters of the
+    sampler (e.g., the tuned HMC step size), the state of `engines` (all engines the
+    sampler draws from), the accumulated result and the position in the run.
+
+    If `path` holds a valid checkpoint when run() is called, the burn-in is skipped and
+    the run continues from the checkpoint. Called with the same arguments, it then
+    produces bit-for-bit the same result as a run that was never interrupted. The
+    checkpoint stores a fingerprint of the run: the arguments of run() (apart from the
+    initial path), the QOI and its number of components, and the parameters passed to
+    set_checkpoint_parameters. A checkpoint that was written by a different run (e.g.,
+    with another target error, path length or sampler) is not resumed from: the run
+    starts from scratch without writing checkpoints, so that the file is left untouched.
+   */
+  template <typename... Engines>
+  void enable_checkpoints(std::string path, std::size_t interval, Engines &...engines) {
+    checkpoint_path = std::move(path);
+    checkpoint_interval = interval;
+    save_engines = [&engines...](binary_writer &writer) { writer.write_all(engines...); };
+    load_engines = [&engines...](binary_reader &reader) {
+      return reader.read_all(engines...);
+    };
+  }
+
+  /*
+    Adds `parameters` that single_level_mcmc cannot see itself, typically the action
+    (e.g., harmonic_oscillator_action::save writes m0 and mu2), to the fingerprint of
+    checkpointed runs (see enable_checkpoints).
+   */
+  template <typename... Parameters>
+  void set_checkpoint_parameters(const Parameters &...parameters) {
+    binary_writer writer;
+    writer.write_all(parameters...);
+    run_parameters = writer.get_buffer();
+  }
+
+  /*
+    Makes run() append the QOI value of every sample (and, depending on the header of
+    `writer`, thinned paths) to a trace (see trace.hh). The writer has to outlive the
+    runs.
+
+    With checkpoints (see enable_checkpoints), the trace is flushed before every
+    checkpoint, which stores the number of records written. A resumed run truncates the
+    trace to this number and appends the samples after the checkpoint, so the writer
+    has to be opened with trace_mode::resume. A run that starts from scratch restarts
+    the trace. If the trace is shorter than the checkpoint says, it is not written.
+   */
+  void enable_trace(trace_writer &writer) { trace = &writer; }
+
+  bool adapt_during_burnin = true;
+
+  /*
+    Thinning: run() evaluates the QOI only every `measurement_interval` steps of the chain
+    (max_steps still counts steps). Measurements much closer than the autocorrelation
+    time of the chain are strongly correlated and add little but cost; this matters for
+    expensive QOIs (e.g., two_point_correlator, or a qoi_set of several QOIs). The error
+    of the mean is estimated from the thinned series, so it accounts for the thinning.
+
+    With adapt_measurement_interval, the interval is adapted during the run to about a
+    quarter of the autocorrelation time of the chain, estimated from that of the
+    measurements (the largest one of all components); longer intervals lose information,
+    and the error grows noticeably beyond half of it. After 100, 200, 400, ...
+    measurements (so that estimating tau from stored samples stays cheap), the interval
+    grows to this value if it is larger, but at most doubles per update, so it is not
+    driven by early, unreliable estimates. It never shrinks.
+   */
+  std::size_t measurement_interval = 1;
+  bool adapt_measurement_interval = false;
+
 private:
+  struct measurement_counters {
+    std::size_t steps = 0;
+    std::size_t accepted = 0;
+  };
+
+  template <typename Result> void update_measurement_interval(const Result &result) {
+    double tau = 1;
+    if constexpr (requires { result.num_components(); }) {
+      for (std::size_t i = 0; i < result.num_components(); ++i)
+        tau = std::max(tau, result.integrated_autocorr_time(i).tau);
+    } else {
+      tau = result.integrated_autocorr_time().tau;
+    }
+
+    // The earlier measurements may have been closer, so tau is converted to steps with
+    // the average interval
+    const auto target = static_cast<std::size_t>(0.25 * tau * result.steps_per_sample());
+    measurement_interval = std::clamp(target, measurement_interval,
+                                      2 * measurement_interval);
+  }
+
+  template <typename State, typename Result>
+  void save_checkpoint(const State &current, const Result &result, std::size_t step,
+                       std::size_t required_steps, const measurement_counters &counters) {
+    if (checkpoint_path.empty())
+      return;
+
+    // The trace records counted in the checkpoint have to be on disk
+    std::size_t trace_records = 0;
+    if (trace != nullptr) {
+      if (not trace->flush())
+        std::cerr << "Could not write trace\n";
+      trace_records = trace->num_records();
+    }
+
+    binary_writer writer;
+    writer.write_all(fingerprint, step, required_steps, measurement_interval, counters,
+                     trace_records, current.path, result);
+    if constexpr (checkpointable<Sampler>)
+      writer.write(sampler);
+    save_engines(writer);
+
+    if (not write_checkpoint(checkpoint_path, writer))
+      std::cerr << "Could not write checkpoint " << checkpoint_path << "\n";
+  }
+
+  // Returns false if there is no checkpoint to resume from
+  template <typename State, typename Result>
+  bool load_checkpoint(State &current, State &workspace, Result &result,
+                       std::size_t &step, std::size_t &required_steps,
+                       measurement_counters &counters) {
+    if (checkpoint_path.empty())
+      return false;
+
+    auto reader = read_checkpoint(checkpoint_path);
+    if (not reader)
+      return false;
+
+    // The sampler and the engines are read in place, so keep their state in case the
+    // checkpoint turns out not to match
+    binary_writer backup;
+    if constexpr (checkpointable<Sampler>)
+      backup.write(sampler);
+    save_engines(backup);
+
+    std::vector<char> loaded_fingerprint;
+    std::size_t loaded_step = 0;
+    std::size_t loaded_required_steps = 0;
+    std::size_t loaded_interval = 0;
+    measurement_counters loaded_counters;
+    std::size_t trace_records = 0;
+    PathType path = current.path;
+    Result loaded_result = result;
+    reader->read_all(loaded_fingerprint, loaded_step, loaded_required_steps,
+                     loaded_interval, loaded_counters, trace_records, path,
+                     loaded_result);
+    if constexpr (checkpointable<Sampler>)
+      reader->read(sampler);
+    load_engines(*reader);
+
+    if (not reader->good() || not reader->at_end() || loaded_fingerprint != fingerprint ||
+        path.size() != current.path.size()) {
+      binary_reader restore(backup.get_buffer());
+      if constexpr (checkpointable<Sampler>)
+        restore.read(sampler);
+      load_engines(restore);
+
+      std::cerr << "Checkpoint " << checkpoint_path
+                << " does not match this run, starting without checkpoints\n";
+      checkpoint_path.clear();
+      return false;
+    }
+
+    if (trace != nullptr && not trace->truncate(trace_records)) {
+      std::cerr << "Trace does not contain the samples up to checkpoint "
+                << checkpoint_path << ", not writing it\n";
+      trace = nullptr;
+    }
+
+    step = loaded_step;
+    required_steps = loaded_required_steps;
+    measurement_interval = loaded_interval;
+    counters = loaded_counters;
+    result = std::move(loaded_result);
+    current = sampler.make_state(path);
+    workspace = current;
+    return true;
+  }
+
   Sampler &sampler;
 
+  std::string checkpoint_path;
+  std::size_t checkpoint_interval = 0;
+  std::function<void(binary_writer &)> save_engines;
+  std::function<bool(binary_reader &)> load_engines;
+
+  std::vector<char> run_parameters;
+  std::vector<char> fingerprint;
+
+  trace_writer *trace = nullptr;
+
   std::default_random_engine generator;
   std::uniform_real_distribution<double> unif_dist;
 };
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "mlmcpi/common/control_variate_result.hh"
+
+namespace mlmcpi {
+/*
+  Measures the scalar QOI `QOI` together with the reference QOI `ReferenceQOI`, whose
+  expectation under the sampled action is known exactly, on the same path.
+  single_level_mcmc collects these samples in the control variate result (see
+  control_variate_result.hh), which estimates <QOI> with the reduced variance of
+  QOI - beta (ReferenceQOI - <ReferenceQOI>), and also stops the run once that error
+  reaches the target.
+ */
+template <typename QOI, typename ReferenceQOI> struct control_variate {
+  using ResultType = control_variate_sample;
+
+  template <typename PathType> ResultType operator()(const PathType &path) const {
+    return {{static_cast<double>(qoi(path)), static_cast<double>(reference(path))}};
+  }
+
+  QOI qoi;
+  ReferenceQOI reference;
+};
+} // namespace mlmcpi
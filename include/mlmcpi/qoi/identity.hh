@@ -1,11 +1,10 @@
 #pragma once
 
-#include <utility>
-
 namespace mlmcpi {
+// The path itself, e.g., for the mean of every site (see the vector-valued mcmc_result)
 template <typename DataT> struct identity {
   using ResultType = DataT;
 
-  constexpr DataT &&operator()(DataT &&t) const { return std::forward<DataT>(t); }
+  constexpr const DataT &operator()(const DataT &t) const { return t; }
 };
 } // namespace mlmcpi
@@ -1,11 +1,17 @@
 #pragma once
 
-#include "mlmcpi/common/math.hh"
+#include <cstddef>
 
 namespace mlmcpi {
+// Site average of x^2, computed in a single pass without a temporary for x * x
 template <typename PathType, typename DataT = double> struct mean_displacement {
   using ResultType = DataT;
 
-  ResultType operator()(const PathType &path) { return mean(path * path); }
+  ResultType operator()(const PathType &path) const {
+    DataT sum{0};
+    for (std::size_t i = 0; i < path.size(); ++i)
+      sum += path[i] * path[i];
+    return sum / static_cast<DataT>(path.size());
+  }
 };
 } // namespace mlmcpi
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <span>
+
+namespace mlmcpi {
+/*
+  Site averages of the first `n_moments` powers of the path, (<x>, <x^2>, ..., <x^n>),
+  all computed in a single pass over the path. <x^2> is the mean displacement.
+ */
+template <typename PathType, std::size_t n_moments = 4> struct path_moments {
+  static_assert(n_moments > 0);
+
+  using ResultType = std::array<double, n_moments>;
+
+  static constexpr std::size_t num_components(std::size_t) { return n_moments; }
+
+  void evaluate(const PathType &path, std::span<double> out) const {
+    assert(out.size() == n_moments);
+
+    ResultType sums{};
+    for (std::size_t i = 0; i < path.size(); ++i) {
+      const double x = path[i];
+      double power = x;
+      for (std::size_t k = 0; k < n_moments; ++k) {
+        sums[k] += power;
+        power *= x;
+      }
+    }
+
+    for (std::size_t k = 0; k < n_moments; ++k)
+      out[k] = sums[k] / static_cast<double>(path.size());
+  }
+
+  ResultType operator()(const PathType &path) const {
+    ResultType res;
+    evaluate(path, res);
+    return res;
+  }
+};
+} // namespace mlmcpi
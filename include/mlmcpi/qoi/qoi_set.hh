@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Several QOIs evaluated on the same sample, e.g.,
+  qoi_set<Path, path_moments<Path>, two_point_correlator<Path>>. Their values are
+  concatenated into one vector-valued result, for which mcmc_result accumulates
+  per-component statistics. Every QOI writes its values directly into the result buffer
+  (a scalar QOI fills one component), so after the first sample no memory is allocated.
+
+  Vector-valued member QOIs provide num_components(path_length) and
+  evaluate(path, std::span<double>). offset<I>(path_length) is the index of the first
+  component of the I-th QOI.
+ */
+template <typename PathType, typename... QOIs> class qoi_set {
+public:
+  using ResultType = std::vector<double>;
+
+  static std::size_t num_components(std::size_t path_length) {
+    return (std::size_t{0} + ... + components<QOIs>(path_length));
+  }
+
+  template <std::size_t I> static std::size_t offset(std::size_t path_length) {
+    return [path_length]<std::size_t... J>(std::index_sequence<J...>) {
+      return (std::size_t{0} + ... +
+              components<std::tuple_element_t<J, std::tuple<QOIs...>>>(path_length));
+    }(std::make_index_sequence<I>{});
+  }
+
+  void evaluate(const PathType &path, std::span<double> out) {
+    std::size_t offset = 0;
+    std::apply([&](auto &...qoi) { (evaluate_one(qoi, path, out, offset), ...); }, qois);
+  }
+
+  // The returned values are only valid until the next call
+  const ResultType &operator()(const PathType &path) {
+    result.resize(num_components(path.size()));
+    evaluate(path, result);
+    return result;
+  }
+
+private:
+  template <typename QOI> static std::size_t components(std::size_t path_length) {
+    if constexpr (std::is_arithmetic_v<typename QOI::ResultType>)
+      return 1;
+    else
+      return QOI::num_components(path_length);
+  }
+
+  template <typename QOI>
+  static void evaluate_one(QOI &qoi, const PathType &path, std::span<double> out,
+                           std::size_t &offset) {
+    const auto n = components<QOI>(path.size());
+    if constexpr (std::is_arithmetic_v<typename QOI::ResultType>)
+      out[offset] = static_cast<double>(qoi(path));
+    else
+      qoi.evaluate(path, out.subspan(offset, n));
+    offset += n;
+  }
+
+  std::tuple<QOIs...> qois;
+  ResultType result;
+};
+} // namespace mlmcpi
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mlmcpi/common/fft.hh"
+
+#include <cassert>
+#include <complex>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Euclidean two-point correlator of a periodic path, C(tau) = 1/N sum_t x_t x_{t+tau} for
+  tau = 0, ..., N/2 (the others follow from C(N - tau) = C(tau)). By the
+  Wiener-Khinchin theorem C is the inverse DFT of the power spectrum |x_k|^2 / N, so all
+  separations cost O(N log N) instead of O(N^2). C(0) is the mean displacement.
+
+  Holds an FFT plan and scratch storage, which are set up for the first path length.
+ */
+template <typename PathType> class two_point_correlator {
+public:
+  using ResultType = std::vector<double>;
+
+  static std::size_t num_components(std::size_t path_length) {
+    return path_length / 2 + 1;
+  }
+
+  void evaluate(const PathType &path, std::span<double> out) {
+    const auto n = path.size();
+    assert(out.size() == num_components(n));
+
+    if (plan.size() != n) {
+      plan = fft_plan(n);
+      buffer.resize(n);
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+      buffer[i] = path[i];
+
+    plan.forward(buffer);
+    for (auto &x : buffer)
+      x = std::norm(x);
+    plan.inverse(buffer);
+
+    const auto scale = 1. / static_cast<double>(n);
+    for (std::size_t tau = 0; tau < out.size(); ++tau)
+      out[tau] = buffer[tau].real() * scale;
+  }
+
+  // The returned values are only valid until the next call
+  const ResultType &operator()(const PathType &path) {
+    result.resize(num_components(path.size()));
+    evaluate(path, result);
+    return result;
+  }
+
+private:
+  fft_plan plan;
+  std::vector<std::complex<double>> buffer;
+  ResultType result;
+};
+} // namespace mlmcpi
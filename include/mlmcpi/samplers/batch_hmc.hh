@@ -0,0 +1,225 @@
+#pragma once
+
+#include "mlmcpi/common/path_ensemble.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/samplers/dual_averaging.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  K independent HMC chains advancing in lock-step. The paths of all chains are stored in
+  a path ensemble (see path_ensemble.hh), so the leapfrog updates and the batched action
+  and gradient kernels of the action (evaluate_batch, grad_potential_batch) process all
+  chains in one vectorised pass per site. The chains share the (jittered) step size of a
+  trajectory, but every chain has its own momenta and its own accept/reject decision.
+
+  The sampler only supports the identity mass matrix and the leapfrog integrator; during
+  the adaptation phase the step size is tuned with dual averaging on the mean acceptance
+  statistic of all chains.
+ */
+template <typename Action, typename Engine = std::mt19937> class batch_hmc_sampler {
+public:
+  using PathType = typename Action::PathType;
+
+  struct State {
+    path_ensemble<double> paths;
+    std::vector<double> actions;
+  };
+
+  batch_hmc_sampler(double stepsize, Action &action_, Engine &engine_,
+                    std::size_t n_steps_ = 100)
+      : dt{stepsize},
+        n_steps{n_steps_},
+        action{action_},
+        engine{engine_} {
+    assert(n_steps > 0);
+  }
+
+  // All `n_chains` chains start at `path`
+  State make_state(const PathType &path, std::size_t n_chains) {
+    State state{path_ensemble<double>(path.size(), n_chains), {}};
+    for (std::size_t k = 0; k < n_chains; ++k)
+      state.paths.set_path(k, path);
+    action.evaluate_batch(state.paths, state.actions);
+    return state;
+  }
+
+  /*
+    Performs one HMC step for all chains in place and returns the number of accepted
+    proposals; was_accepted(k) tells whether chain k moved.
+   */
+  std::size_t perform_step(State &state) {
+    const auto n = state.paths.get_path_length();
+    const auto n_chains = state.paths.num_paths();
+    if (position.get_path_length() != n || position.num_paths() != n_chains) {
+      position = path_ensemble<double>(n, n_chains);
+      momentum = path_ensemble<double>(n, n_chains);
+      force = path_ensemble<double>(n, n_chains);
+      kinetic.resize(n_chains);
+      initial_kinetic.resize(n_chains);
+      accepted.resize(n_chains);
+    }
+    std::copy_n(state.paths.data(), n * n_chains, position.data());
+
+    fill_normal(engine, std::span<double>{momentum.data(), n * n_chains});
+    compute_kinetic_energies();
+    kinetic.swap(initial_kinetic);
+
+    // Randomise the step size of every trajectory, see hmc_sampler
+    const auto dt_tuned = dt;
+    if (stepsize_jitter > 0)
+      dt *= 1 + stepsize_jitter * (2 * unif_dist(engine) - 1);
+
+    integrate_leapfrog();
+    dt = dt_tuned;
+
+    compute_kinetic_energies();
+    action.evaluate_batch(position, proposal_actions);
+
+    std::size_t n_accepted = 0;
+    double acceptance_statistic_sum = 0;
+    for (std::size_t k = 0; k < n_chains; ++k) {
+      const auto delta_H = proposal_actions[k] - state.actions[k] + kinetic[k] -
+                           initial_kinetic[k];
+
+      bool accept = true;
+      // NaN is rejected, as in hmc_sampler
+      if (not(delta_H < 0))
+        accept = unif_dist(engine) < std::exp(-delta_H);
+
+      accepted[k] = accept;
+      if (accept) {
+        state.actions[k] = proposal_actions[k];
+        n_accepted++;
+      }
+
+      if (not std::isnan(delta_H))
+        acceptance_statistic_sum += std::min(1., std::exp(-delta_H));
+    }
+
+    // Blend the accepted proposals into the state, site by site
+    for (std::size_t i = 0; i < n; ++i) {
+      double *__restrict x = state.paths.site(i);
+      const double *__restrict y = position.site(i);
+      for (std::size_t k = 0; k < n_chains; ++k)
+        x[k] = accepted[k] ? y[k] : x[k];
+    }
+
+    if (adapting)
+      dt = stepsize_adaptation.update(acceptance_statistic_sum /
+                                      static_cast<double>(n_chains));
+
+    return n_accepted;
+  }
+
+  bool was_accepted(std::size_t chain) const { return accepted[chain]; }
+
+  void start_adaptation(std::size_t) {
+    adapting = true;
+    stepsize_adaptation.restart(dt, acceptance_rate_target);
+  }
+
+  void stop_adaptation() {
+    if (not adapting)
+      return;
+
+    adapting = false;
+    if (stepsize_adaptation.num_updates() > 0)
+      dt = stepsize_adaptation.final_stepsize();
+  }
+
+  void set_target_acceptance_rate(double acceptance_rate_target_) {
+    acceptance_rate_target = acceptance_rate_target_;
+  }
+
+  double get_stepsize() const { return dt; }
+  void set_stepsize(double stepsize) { dt = stepsize; }
+
+  std::size_t get_trajectory_steps() const { return n_steps; }
+  void set_trajectory_steps(std::size_t n_steps_) {
+    assert(n_steps_ > 0);
+    n_steps = n_steps_;
+  }
+
+  double get_stepsize_jitter() const { return stepsize_jitter; }
+  void set_stepsize_jitter(double jitter) {
+    assert(jitter >= 0 && jitter < 1);
+    stepsize_jitter = jitter;
+  }
+
+private:
+  void integrate_leapfrog() {
+    action.grad_potential_batch(position, force);
+    kick_drift(0.5 * dt, dt);
+
+    for (std::size_t k = 1; k < n_steps; ++k) {
+      action.grad_potential_batch(position, force);
+      kick_drift(dt, dt);
+    }
+
+    action.grad_potential_batch(position, force);
+    kick(0.5 * dt);
+  }
+
+  void kick_drift(double dt_momentum, double dt_position) {
+    const auto size = position.get_path_length() * position.num_paths();
+    double *__restrict x = position.data();
+    double *__restrict p = momentum.data();
+    const double *__restrict f = force.data();
+
+    for (std::size_t i = 0; i < size; ++i) {
+      p[i] -= dt_momentum * f[i];
+      x[i] += dt_position * p[i];
+    }
+  }
+
+  void kick(double dt_momentum) {
+    const auto size = momentum.get_path_length() * momentum.num_paths();
+    double *__restrict p = momentum.data();
+    const double *__restrict f = force.data();
+
+    for (std::size_t i = 0; i < size; ++i)
+      p[i] -= dt_momentum * f[i];
+  }
+
+  void compute_kinetic_energies() {
+    std::fill(kinetic.begin(), kinetic.end(), 0.);
+
+    double *__restrict t = kinetic.data();
+    for (std::size_t i = 0; i < momentum.get_path_length(); ++i) {
+      const double *__restrict p = momentum.site(i);
+      for (std::size_t k = 0; k < momentum.num_paths(); ++k)
+        t[k] += 0.5 * p[k] * p[k];
+    }
+  }
+
+  double dt;
+  double stepsize_jitter = 0.2;
+  std::size_t n_steps;
+
+  const Action &action;
+
+  Engine &engine;
+  std::uniform_real_distribution<double> unif_dist;
+
+  bool adapting = false;
+  double acceptance_rate_target = 0.8;
+  dual_averaging stepsize_adaptation;
+
+  path_ensemble<double> position;
+  path_ensemble<double> momentum;
+  path_ensemble<double> force;
+  std::vector<double> kinetic;
+  std::vector<double> initial_kinetic;
+  std::vector<double> proposal_actions;
+  std::vector<char> accepted;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "mlmcpi/common/partition.hh"
+#include "mlmcpi/samplers/sampler.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <utility>
+
+namespace mlmcpi {
+/*
+  Coupled chains on the levels l - 1 and l for the correction term E[Q_l - Q_{l-1}] of
+  the multilevel estimator, see [2] in the README and Dodwell et al., "A hierarchical
+  multilevel Markov chain Monte Carlo algorithm" (2015).
+
+  The coarse chain is advanced by the coarse sampler (any sampler on level l - 1, e.g.,
+  HMC or a two-level or multilevel sampler) independently of the fine chain, so its
+  states follow the level l - 1 distribution. Every fine proposal takes the current
+  coarse state as its even sites and samples the odd sites from the odd-even
+  conditional. It is accepted with the same probability as in the two-level sampler.
+  Since fine and coarse state share their even sites whenever a proposal is accepted, Q_l
+  and Q_{l-1} are strongly correlated and the variance of their difference is small.
+
+  Unlike the fine chain of the two-level sampler, the coarse chain is not reset if the
+  fine proposal is rejected. The acceptance probability assumes that the proposals are
+  independent samples of the coarse distribution, so `coarse_steps` coarse steps are
+  performed per fine step. This should be of the order of the integrated autocorrelation
+  time of the coarse chain; too small values bias the fine chain.
+ */
+template <typename Action, typename CoarseSampler, typename OddEvenConditional,
+          typename Engine>
+struct coupled_level_sampler {
+  using PathType = typename Action::PathType;
+
+  struct State {
+    PathType path;
+    double action = 0;
+    double conditional_log_density = 0;
+    // Coarse action of the even sites of `path`
+    double coarse_action = 0;
+
+    typename CoarseSampler::State coarse;
+  };
+
+  coupled_level_sampler(Action &action_, CoarseSampler &coarse_sampler_,
+                        OddEvenConditional &odd_even_conditional_, Engine &engine_,
+                        std::size_t coarse_steps_)
+      : action{action_},
+        coarse_sampler{coarse_sampler_},
+        odd_even_conditional{odd_even_conditional_},
+        engine{engine_},
+        coarse_steps{coarse_steps_},
+        proposal(action.get_path_length()) {
+    assert(coarse_steps > 0);
+  }
+
+  // Both chains start from `path`, i.e., the coarse chain starts from its even sites
+  State make_state(const PathType &path) {
+    PathType even(path.size() / 2);
+    assign_sites(even_sites(path), even);
+
+    State state{path, action.evaluate(path), odd_even_conditional.log_density(path), 0,
+                coarse_sampler.make_state(even)};
+    state.coarse_action = state.coarse.action;
+    coarse_workspace = state.coarse;
+    return state;
+  }
+
+  bool advance(State &state) {
+    run_steps(coarse_sampler, state.coarse, coarse_workspace, coarse_steps);
+
+    assign_sites(state.coarse.path, even_sites(proposal));
+    odd_even_conditional.sample_odd_sites(proposal);
+    const auto proposal_action = action.evaluate(proposal);
+    const auto proposal_log_density = odd_even_conditional.log_density(proposal);
+
+    const auto fine_action_diff = proposal_action - state.action;
+    const auto conditional_diff = state.conditional_log_density - proposal_log_density;
+    const auto coarse_action_diff = state.coarse_action - state.coarse.action;
+
+    const auto delta_S = fine_action_diff + conditional_diff + coarse_action_diff;
+
+    bool accept = true;
+    // NaN is rejected, see two_level_sampler
+    if (not(delta_S < 0)) {
+      const auto acceptance_prob = std::exp(-delta_S);
+      accept = unif_dist(engine) < acceptance_prob;
+    }
+
+    if (not accept)
+      return false;
+
+    // The old path becomes the buffer for the next proposal
+    std::swap(state.path, proposal);
+    state.action = proposal_action;
+    state.conditional_log_density = proposal_log_density;
+    state.coarse_action = state.coarse.action;
+    return true;
+  }
+
+  // Only the coarse sampler has parameters to tune
+  void start_adaptation(std::size_t n_adaptation_steps)
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.start_adaptation(n_adaptation_steps);
+  }
+
+  void stop_adaptation()
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.stop_adaptation();
+  }
+
+private:
+  Action &action;
+  CoarseSampler &coarse_sampler;
+  OddEvenConditional &odd_even_conditional;
+
+  Engine &engine;
+  std::uniform_real_distribution<double> unif_dist;
+
+  std::size_t coarse_steps;
+  PathType proposal;
+  typename CoarseSampler::State coarse_workspace;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+namespace mlmcpi {
+
+/*
+  Nesterov's dual averaging scheme for step size adaptation as proposed by Hoffman &
+  Gelman (2014), "The No-U-Turn Sampler", Algorithm 5. After every step the observed
+  acceptance statistic alpha = min(1, exp(-delta_H)) is fed to update(), which returns
+  the step size for the next step. The averaged step size returned by final_stepsize()
+  is the one that should be used after the adaptation phase.
+ */
+class dual_averaging {
+public:
+  void restart(double initial_stepsize, double acceptance_rate_target_) {
+    acceptance_rate_target = acceptance_rate_target_;
+    mu = std::log(10 * initial_stepsize);
+    h_bar = 0;
+    log_stepsize_bar = std::log(initial_stepsize);
+    t = 0;
+  }
+
+  double update(double acceptance_statistic) {
+    if (not std::isfinite(acceptance_statistic))
+      acceptance_statistic = 0;
+
+    t++;
+    const auto td = static_cast<double>(t);
+
+    const auto w = 1. / (td + t0);
+    h_bar = (1 - w) * h_bar + w * (acceptance_rate_target - acceptance_statistic);
+
+    const auto log_stepsize = mu - std::sqrt(td) / gamma * h_bar;
+    const auto eta = std::pow(td, -kappa);
+    log_stepsize_bar = eta * log_stepsize + (1 - eta) * log_stepsize_bar;
+
+    return std::exp(log_stepsize);
+  }
+
+  double final_stepsize() const { return std::exp(log_stepsize_bar); }
+
+  std::size_t num_updates() const { return t; }
+
+private:
+  // Parameters recommended by Hoffman & Gelman
+  static constexpr double gamma = 0.05;
+  static constexpr double t0 = 10;
+  static constexpr double kappa = 0.75;
+
+  double acceptance_rate_target = 0.8;
+  double mu = 0;
+  double h_bar = 0;
+  double log_stepsize_bar = 0;
+  std::size_t t = 0;
+};
+
+} // namespace mlmcpi
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mlmcpi/common/circulant.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/samplers/sampler.hh"
+
+#include <cassert>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mlmcpi {
+/*
+  Exact sampler for Gaussian actions S(x) = 0.5 x^T C x with a circulant precision matrix
+  C, given by the action's circulant_kernel() (e.g., the harmonic oscillator). Paths
+  x = C^{-1/2} xi with xi ~ N(0, I) are drawn with two FFTs in O(n log n).
+
+  Every step returns an independent sample from the target, i.e., the chain always
+  accepts and has no autocorrelation. As the coarse sampler of two_level_sampler or
+  multilevel_sampler this leaves only the corrections on the finer levels to be paid for.
+ */
+template <typename Action, typename Engine = std::mt19937>
+struct gaussian_direct_sampler {
+  using PathType = typename Action::PathType;
+  using State = sampler_state<PathType>;
+
+  gaussian_direct_sampler(const Action &action_, Engine &engine_)
+      : action{action_},
+        engine{engine_},
+        op{action.circulant_kernel()},
+        noise(action.get_path_length()) {
+    for ([[maybe_unused]] const auto lambda : op.get_eigenvalues())
+      assert(lambda > 0 && "Precision matrix must be positive definite");
+
+    inv_sqrt_spectrum = op.spectrum_power(-0.5);
+  }
+
+  State make_state(const PathType &path) { return {path, action.evaluate(path)}; }
+
+  // The new path does not depend on the current one
+  bool step(State &current, State &workspace) {
+    fill_normal(engine, std::span<double>{noise});
+
+    op.apply_spectral(noise, workspace.path, inv_sqrt_spectrum);
+    workspace.action = action.evaluate(workspace.path);
+
+    std::swap(current, workspace);
+    return true;
+  }
+
+private:
+  const Action &action;
+  Engine &engine;
+
+  circulant_operator op;
+  std::vector<double> inv_sqrt_spectrum;
+  std::vector<double> noise;
+};
+
+} // namespace mlmcpi
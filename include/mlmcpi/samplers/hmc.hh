@@ -1,126 +1,518 @@
 #pragma once
 
 #include "mlmcpi/common/math.hh"
+#include "mlmcpi/common/mcmc_result.hh"
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/samplers/dual_averaging.hh"
+#include "mlmcpi/samplers/mass_matrices.hh"
 #include "mlmcpi/samplers/sampler.hh"
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <optional>
 #include <random>
+#include <span>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 namespace mlmcpi {
-template <typename Action, typename Engine = std::mt19937>
-struct hmc_sampler : sampler<Action> {
+
+/*
+  Symplectic integrators for the molecular dynamics part of HMC:
+  - leapfrog: second order, one gradient evaluation per step
+  - omelyan: second order minimum norm scheme (2MN) of Omelyan, Mryglod and Folk, two
+    gradient evaluations per step but a much smaller error constant
+  - force_gradient: fourth order force gradient scheme; the force gradient term is
+    approximated by evaluating the force at a shifted position (Yin & Mawhinney), which
+    costs three gradient evaluations per step
+ */
+enum class hmc_integrator { leapfrog, omelyan, force_gradient };
+
+struct hmc_tuning_result {
+  hmc_integrator integrator;
+  std::size_t n_steps;
+  double stepsize;
+  double ess_per_gradient;
+};
+
+/*
+  Hybrid Monte Carlo sampler. The kinetic term is 0.5 * p^T M^{-1} p with a mass matrix M
+  provided by `MassMatrix` (see mass_matrices.hh); the default is the identity.
+ */
+template <typename Action, typename Engine = std::mt19937,
+          typename MassMatrix = identity_mass<typename Action::PathType>>
+struct hmc_sampler {
   using PathType = typename Action::PathType;
+  using State = sampler_state<PathType>;
 
-  hmc_sampler(double stepsize, Action &action_, Engine &engine_)
+  hmc_sampler(double stepsize, Action &action_, Engine &engine_,
+              std::size_t n_steps_ = 100,
+              hmc_integrator integrator_ = hmc_integrator::leapfrog,
+              MassMatrix mass_ = MassMatrix{})
       : dt{stepsize},
+        n_steps{n_steps_},
+        integrator{integrator_},
         action{action_},
-        engine{engine_} {}
+        engine{engine_},
+        mass{std::move(mass_)} {
+    assert(n_steps > 0);
+  }
 
-  std::optional<PathType> perform_step(const PathType &current) override {
-    const auto [proposal, delta_H] = generate_proposal(current);
+  State make_state(const PathType &path) { return {path, action.evaluate(path)}; }
 
-    if (delta_H < 0)
-      return proposal;
+  // The trajectory is integrated in a buffer of the sampler, see generate_proposal
+  bool step(State &current, State &workspace) {
+    const auto [proposal, proposal_action, delta_H] = generate_proposal(current);
 
-    auto acceptance_prob = std::exp(-delta_H);
-    if (unif_dist(engine) < acceptance_prob)
-      return proposal;
-    else
-      return {};
+    bool accept = true;
+    // NaN, e.g. from a diverged trajectory, fails both tests and is rejected
+    if (not(delta_H < 0)) {
+      auto acceptance_prob = std::exp(-delta_H);
+      accept = unif_dist(engine) < acceptance_prob;
+    }
+
+    if (adapting) {
+      const auto acceptance_statistic =
+          std::isnan(delta_H) ? 0. : std::min(1., std::exp(-delta_H));
+      adapt(acceptance_statistic, accept ? proposal : current.path);
+    }
+
+    if (not accept)
+      return false;
+
+    // The end point becomes the current path, the previous one moves to the workspace
+    // and the old workspace path is the buffer for the next trajectory
+    std::swap(workspace.path, current.path);
+    std::swap(current.path, position);
+    workspace.action = current.action;
+    current.action = proposal_action;
+    return true;
   }
 
+  /*
+    Starts adapting the step size (and, for adaptive mass matrices, the mass matrix)
+    during the next `n_adaptation_steps` calls of step. The step size is tuned
+    with dual averaging towards the target acceptance rate. An adaptive mass matrix is
+    estimated from the positions visited between 10% and 50% of the adaptation phase,
+    after which the step size adaptation is restarted.
+   */
+  void start_adaptation(std::size_t n_adaptation_steps) {
+    adapting = true;
+    adaptation_steps = n_adaptation_steps;
+    adaptation_step = 0;
+    stepsize_adaptation.restart(dt, acceptance_rate_target);
+
+    if constexpr (MassMatrix::is_adaptive) {
+      position_count = 0;
+      position_mean.clear();
+      position_m2.clear();
+    }
+  }
+
+  // Ends the adaptation phase and freezes the step size at its averaged value
+  void stop_adaptation() {
+    if (not adapting)
+      return;
+
+    adapting = false;
+    if (stepsize_adaptation.num_updates() > 0)
+      dt = stepsize_adaptation.final_stepsize();
+  }
+
+  void set_target_acceptance_rate(double acceptance_rate_target_) {
+    acceptance_rate_target = acceptance_rate_target_;
+  }
+
+  /*
+    Runs `n_adaptation_steps` trajectories starting at `initial_path` while adapting the
+    step size (see start_adaptation). Returns the tuned step size, or nothing if the
+    adaptation did not produce a usable step size.
+   */
   std::optional<double> autotune_stepsize(const PathType &initial_path,
-                                          double acceptance_rate_target = 0.85) {
-    const std::size_t n_samples = 1000;
-    const std::size_t n_repetitions = 100;
+                                          double acceptance_rate_target_ = 0.85,
+                                          std::size_t n_adaptation_steps = 2000) {
     const double dt_initial = dt;
 
-    double dt_min = 0.1 * dt;
-    double dt_max = 10 * dt;
+    set_target_acceptance_rate(acceptance_rate_target_);
+    start_adaptation(n_adaptation_steps);
 
-    auto current = initial_path;
+    auto current = make_state(initial_path);
+    auto workspace = current;
+    run_steps(*this, current, workspace, n_adaptation_steps);
 
-    // Perform burnin
-    std::size_t n_burnin = 100;
-    for (std::size_t i = 0; i < n_burnin; ++i) {
-      auto proposal = perform_step(current);
-      current = proposal.value_or(current);
+    stop_adaptation();
+
+    if (not std::isfinite(dt) || dt <= 0) {
+      dt = dt_initial;
+      return {};
     }
+    return dt;
+  }
+
+  /*
+    Tunes the step size for every combination of integrator and number of steps and keeps
+    the combination that produces the most effective samples per gradient evaluation. The
+    integrated autocorrelation time is measured on the action, using `n_samples`
+    trajectories per combination.
+   */
+  std::optional<hmc_tuning_result> autotune_trajectory(
+      const PathType &initial_path, double acceptance_rate_target_ = 0.85,
+      const std::vector<std::size_t> &candidate_steps = {10, 25, 50, 100},
+      const std::vector<hmc_integrator> &candidate_integrators =
+          {hmc_integrator::leapfrog, hmc_integrator::omelyan,
+           hmc_integrator::force_gradient},
+      std::size_t n_samples = 1000) {
+    const double dt_initial = dt;
+    const auto n_steps_initial = n_steps;
+    const auto integrator_initial = integrator;
+
+    std::optional<hmc_tuning_result> best;
 
-    for (std::size_t run = 0; run < n_repetitions; ++run) {
-      std::size_t accepted_samples = 0;
+    for (const auto candidate_integrator : candidate_integrators) {
+      for (const auto candidate_n_steps : candidate_steps) {
+        integrator = candidate_integrator;
+        n_steps = candidate_n_steps;
+        dt = dt_initial;
 
-      dt = 0.5 * (dt_min + dt_max);
-      for (std::size_t i = 0; i < n_samples; ++i) {
-        auto proposal = perform_step(current);
-        if (proposal) {
-          current = proposal.value();
-          accepted_samples++;
+        if (not autotune_stepsize(initial_path, acceptance_rate_target_))
+          continue;
+
+        mcmc_result<double> trace(true);
+        auto current = make_state(initial_path);
+        auto workspace = current;
+        for (std::size_t i = 0; i < n_samples; ++i) {
+          const bool accepted = step(current, workspace);
+          trace.add_sample(current.action, accepted);
         }
-      }
 
-      const auto acceptance_rate = (1. * accepted_samples) / n_samples;
-      if (acceptance_rate > acceptance_rate_target)
-        dt_min = dt;
-      else
-        dt_max = dt;
+        const auto tau = trace.integrated_autocorr_time().tau;
+        const auto ess_per_gradient =
+            1. / (tau * static_cast<double>(gradient_evaluations_per_trajectory()));
 
-      if (std::abs(acceptance_rate - acceptance_rate_target) < 1e-2)
-        return dt;
+        if (not best || ess_per_gradient > best->ess_per_gradient)
+          best = hmc_tuning_result{integrator, n_steps, dt, ess_per_gradient};
+      }
     }
 
-    dt = dt_initial;
-    return {};
-  }
+    if (best) {
+      integrator = best->integrator;
+      n_steps = best->n_steps;
+      dt = best->stepsize;
+    } else {
+      integrator = integrator_initial;
+      n_steps = n_steps_initial;
+      dt = dt_initial;
+    }
 
-  std::pair<PathType, double> generate_proposal(const PathType &current) {
-    auto position = current;
+    return best;
+  }
 
-    PathType momentum(current.size());
-    std::generate(momentum.begin(), momentum.end(),
-                  [&]() { return normal_dist(engine); });
+  /*
+    Integrates Hamilton's equations with the selected integrator, starting at `current`
+    with freshly drawn momenta. Returns the end point, its action and the change in the
+    Hamiltonian. The end point is stored in a buffer owned by the sampler, so the returned
+    reference is only valid until the next call.
+   */
+  std::tuple<const PathType &, double, double> generate_proposal(const State &current) {
+    const auto n = current.path.size();
+    if (momentum.size() != n) {
+      momentum.resize(n);
+      force.resize(n);
+      if constexpr (not MassMatrix::is_identity)
+        velocity.resize(n);
+    }
+    position = current.path;
 
+    // For p = M^{1/2} xi, the kinetic energy 0.5 * p^T M^{-1} p is just 0.5 * |xi|^2
+    fill_normal(engine, std::span<double>{momentum.data(), momentum.size()});
     auto initial_kinetic = 0.5 * sqrNorm(momentum);
+    mass.transform_noise(momentum);
 
-    constexpr int timesteps = 100;
-    for (int k = 0; k < timesteps; ++k) {
-      auto dt_momentum = dt;
-      auto dt_position = dt;
+    // Randomise the step size of every trajectory to avoid (near) periodic trajectories,
+    // which would prevent some modes from mixing
+    const auto dt_tuned = dt;
+    if (stepsize_jitter > 0)
+      dt *= 1 + stepsize_jitter * (2 * unif_dist(engine) - 1);
 
-      if (k == 0)
-        dt_momentum = 0.5 * dt;
-      if (k == timesteps - 1) {
-        dt_momentum = 0.5 * dt;
-        dt_position = 0;
-      }
-
-      auto grad_potential = action.grad_potential(position);
-      momentum -= dt_momentum * grad_potential;
-      position += dt_position * momentum;
+    switch (integrator) {
+    case hmc_integrator::leapfrog:
+      integrate_leapfrog();
+      break;
+    case hmc_integrator::omelyan:
+      integrate_omelyan();
+      break;
+    case hmc_integrator::force_gradient:
+      integrate_force_gradient();
+      break;
+    default:
+      assert(false && "Unknown integrator");
     }
 
-    auto final_kinetic = 0.5 * sqrNorm(momentum);
+    dt = dt_tuned;
 
-    const auto delta_S = action.evaluate(position) - action.evaluate(current);
+    auto final_kinetic = mass.kinetic_energy(momentum);
+
+    const auto proposal_action = action.evaluate(position);
+    const auto delta_S = proposal_action - current.action;
     const auto delta_T = final_kinetic - initial_kinetic;
     const auto delta_H = delta_S + delta_T;
 
-    return {position, delta_H};
+    return {position, proposal_action, delta_H};
+  }
+
+  std::size_t gradient_evaluations_per_trajectory() const {
+    switch (integrator) {
+    case hmc_integrator::leapfrog:
+      return n_steps + 1;
+    case hmc_integrator::omelyan:
+      return 2 * n_steps + 1;
+    case hmc_integrator::force_gradient:
+      return 3 * n_steps + 1;
+    default:
+      return 0;
+    }
+  }
+
+  double get_stepsize() const { return dt; }
+  void set_stepsize(double stepsize) { dt = stepsize; }
+
+  std::size_t get_trajectory_steps() const { return n_steps; }
+  void set_trajectory_steps(std::size_t n_steps_) {
+    assert(n_steps_ > 0);
+    n_steps = n_steps_;
+  }
+
+  // The step size of every trajectory is drawn uniformly from
+  // dt * [1 - jitter, 1 + jitter]
+  double get_stepsize_jitter() const { return stepsize_jitter; }
+  void set_stepsize_jitter(double jitter) {
+    assert(jitter >= 0 && jitter < 1);
+    stepsize_jitter = jitter;
+  }
+
+  hmc_integrator get_integrator() const { return integrator; }
+  void set_integrator(hmc_integrator integrator_) { integrator = integrator_; }
+
+  /*
+    Checkpointing (see checkpoint.hh) of the tuned parameters, including an adapted mass
+    matrix. The state of an unfinished adaptation phase is not saved, so checkpoints
+    should be written after stop_adaptation(). The engine is shared with other samplers
+    and saved by the driver.
+   */
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(dt, stepsize_jitter, n_steps, integrator, acceptance_rate_target);
+    if constexpr (MassMatrix::is_adaptive)
+      writer.write(mass);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(dt, stepsize_jitter, n_steps, integrator, acceptance_rate_target);
+    if constexpr (MassMatrix::is_adaptive)
+      reader.read(mass);
   }
 
 private:
+  void adapt(double acceptance_statistic, const PathType &state) {
+    adaptation_step++;
+    dt = stepsize_adaptation.update(acceptance_statistic);
+
+    if constexpr (MassMatrix::is_adaptive) {
+      const auto window_begin = adaptation_steps / 10;
+      const auto window_end = adaptation_steps / 2;
+      if (window_end - window_begin < 10)
+        return;
+
+      if (adaptation_step > window_begin && adaptation_step <= window_end) {
+        if (position_mean.empty()) {
+          position_mean.assign(state.size(), 0.);
+          position_m2.assign(state.size(), 0.);
+        }
+
+        position_count++;
+        const auto n = static_cast<double>(position_count);
+        for (std::size_t i = 0; i < state.size(); ++i) {
+          const auto delta = state[i] - position_mean[i];
+          position_mean[i] += delta / n;
+          position_m2[i] += delta * (state[i] - position_mean[i]);
+        }
+      }
+
+      if (adaptation_step == window_end) {
+        // Regularise the estimate towards the identity as proposed in Stan
+        const auto n = static_cast<double>(position_count);
+        std::vector<double> variances(position_m2.size());
+        for (std::size_t i = 0; i < variances.size(); ++i)
+          variances[i] = n / (n + 5) * position_m2[i] / (n - 1) + 1e-3 * 5 / (n + 5);
+        mass.set_variances(variances);
+
+        stepsize_adaptation.restart(dt, acceptance_rate_target);
+      }
+    }
+  }
+
+  /*
+    In all integrators, consecutive momentum updates at the boundary between two steps
+    are merged, so the gradient is only evaluated once there.
+   */
+
+  // Half step for the momentum, then alternating full steps for position and momentum
+  // and a final half step for the momentum
+  void integrate_leapfrog() {
+    action.grad_potential_into(position, force);
+    kick_drift(0.5 * dt, dt);
+
+    for (std::size_t k = 1; k < n_steps; ++k) {
+      action.grad_potential_into(position, force);
+      kick_drift(dt, dt);
+    }
+
+    action.grad_potential_into(position, force);
+    kick(0.5 * dt);
+  }
+
+  // One step: p(lambda dt) x(dt/2) p((1 - 2 lambda) dt) x(dt/2) p(lambda dt)
+  void integrate_omelyan() {
+    constexpr double lambda = 0.1931833275037836;
+
+    action.grad_potential_into(position, force);
+    kick_drift(lambda * dt, 0.5 * dt);
+
+    for (std::size_t k = 0; k < n_steps; ++k) {
+      if (k > 0) {
+        action.grad_potential_into(position, force);
+        kick_drift(2 * lambda * dt, 0.5 * dt);
+      }
+
+      action.grad_potential_into(position, force);
+      kick_drift((1 - 2 * lambda) * dt, 0.5 * dt);
+    }
+
+    action.grad_potential_into(position, force);
+    kick(lambda * dt);
+  }
+
+  /*
+    One step: p(dt/6) x(dt/2) p~(2dt/3) x(dt/2) p(dt/6), where the middle momentum update
+    uses the force at x - dt^2/24 * grad S(x), which approximates the force gradient term
+    to the required order.
+   */
+  void integrate_force_gradient() {
+    if (shifted_position.size() != position.size())
+      shifted_position.resize(position.size());
+
+    action.grad_potential_into(position, force);
+    kick_drift(dt / 6, 0.5 * dt);
+
+    for (std::size_t k = 0; k < n_steps; ++k) {
+      if (k > 0) {
+        action.grad_potential_into(position, force);
+        kick_drift(dt / 3, 0.5 * dt);
+      }
+
+      action.grad_potential_into(position, force);
+      shift_position(dt * dt / 24);
+      action.grad_potential_into(shifted_position, force);
+      kick_drift(2 * dt / 3, 0.5 * dt);
+    }
+
+    action.grad_potential_into(position, force);
+    kick(dt / 6);
+  }
+
+  // shifted_position = position - eps * M^{-1} force
+  void shift_position(double eps) {
+    const auto n = position.size();
+
+    // M^{-1} force is written into shifted_position before the restrict pointer to it
+    // is taken
+    if constexpr (not MassMatrix::is_identity)
+      mass.velocity(force, shifted_position);
+
+    const double *__restrict x = position.data();
+    double *__restrict y = shifted_position.data();
+
+    if constexpr (MassMatrix::is_identity) {
+      const double *__restrict f = force.data();
+      for (std::size_t i = 0; i < n; ++i)
+        y[i] = x[i] - eps * f[i];
+    } else {
+      for (std::size_t i = 0; i < n; ++i)
+        y[i] = x[i] - eps * y[i];
+    }
+  }
+
+  /*
+    Update p -= dt_momentum * force, x += dt_position * M^{-1} p. For the identity mass
+    matrix both updates are fused into a single pass.
+   */
+  void kick_drift(double dt_momentum, double dt_position) {
+    const auto n = position.size();
+    double *__restrict x = position.data();
+    double *__restrict p = momentum.data();
+
+    if constexpr (MassMatrix::is_identity) {
+      const double *__restrict f = force.data();
+      for (std::size_t i = 0; i < n; ++i) {
+        p[i] -= dt_momentum * f[i];
+        x[i] += dt_position * p[i];
+      }
+    } else {
+      kick(dt_momentum);
+      mass.velocity(momentum, velocity);
+
+      const double *__restrict v = velocity.data();
+      for (std::size_t i = 0; i < n; ++i)
+        x[i] += dt_position * v[i];
+    }
+  }
+
+  void kick(double dt_momentum) {
+    const auto n = momentum.size();
+    double *__restrict p = momentum.data();
+    const double *__restrict f = force.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+      p[i] -= dt_momentum * f[i];
+  }
+
   double dt;
+  double stepsize_jitter = 0.2;
+  std::size_t n_steps;
+  hmc_integrator integrator;
 
   const Action &action;
 
   Engine &engine;
-  std::normal_distribution<double> normal_dist;
-
   std::uniform_real_distribution<double> unif_dist;
+
+  MassMatrix mass;
+
+  // State of the adaptation phase
+  bool adapting = false;
+  double acceptance_rate_target = 0.8;
+  std::size_t adaptation_steps = 0;
+  std::size_t adaptation_step = 0;
+  dual_averaging stepsize_adaptation;
+
+  std::size_t position_count = 0;
+  std::vector<double> position_mean;
+  std::vector<double> position_m2;
+
+  // Scratch buffers for the integrator, reused between trajectories
+  PathType position;
+  PathType momentum;
+  PathType force;
+  PathType shifted_position;
+  PathType velocity; // Only used for non-identity mass matrices
 };
+
+// HMC with the circulant Hessian of a Gaussian action as mass matrix
+template <typename Action, typename Engine = std::mt19937>
+using fourier_hmc_sampler =
+    hmc_sampler<Action, Engine, circulant_mass<typename Action::PathType>>;
+
 } // namespace mlmcpi
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mlmcpi/common/streaming_statistics.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Diagnostics for one level of a two-level or multilevel sampler. `proposals` counts the
+  proposals that reached this level, i.e., that were accepted on all coarser levels. Each
+  of them is then either accepted or rejected on this level.
+
+  For the delayed acceptance levels (all levels except the coarsest one), the
+  distribution of delta_S (the negative log of the acceptance ratio) is recorded: its
+  mean and variance, its range and a histogram with `n_bins` bins on
+  [histogram_min, histogram_max), plus one underflow and one overflow bin. The coarsest
+  level is handled by the coarse sampler, so only its acceptances are counted there.
+  Non-finite values of delta_S (e.g., NaN from inf - inf if the action overflows) would
+  poison the mean and variance; they are only counted in `non_finite` instead.
+ */
+struct level_statistics {
+  static constexpr std::size_t n_bins = 40;
+  static constexpr double histogram_min = -10.;
+  static constexpr double histogram_max = 10.;
+
+  std::size_t proposals = 0;
+  std::size_t accepted = 0;
+  std::size_t rejected = 0;
+  std::size_t non_finite = 0;
+
+  streaming_statistics<double> delta_S;
+  double min_delta_S = std::numeric_limits<double>::infinity();
+  double max_delta_S = -std::numeric_limits<double>::infinity();
+
+  // histogram[0] counts delta_S < histogram_min, histogram[n_bins + 1] the values above
+  std::vector<std::size_t> histogram = std::vector<std::size_t>(n_bins + 2, 0);
+
+  // Sum of the acceptance probabilities min(1, exp(-delta_S))
+  double acceptance_probability_sum = 0;
+
+  void add(bool was_accepted) {
+    proposals++;
+    if (was_accepted)
+      accepted++;
+    else
+      rejected++;
+  }
+
+  void add(double delta_S_, bool was_accepted) {
+    add(was_accepted);
+
+    // The samplers reject NaN, so only -inf has a nonzero acceptance probability
+    if (not std::isnan(delta_S_))
+      acceptance_probability_sum += std::min(1., std::exp(-delta_S_));
+
+    if (not std::isfinite(delta_S_)) {
+      non_finite++;
+      return;
+    }
+
+    delta_S.add(delta_S_);
+    min_delta_S = std::min(min_delta_S, delta_S_);
+    max_delta_S = std::max(max_delta_S, delta_S_);
+    histogram[bin(delta_S_)]++;
+  }
+
+  double acceptance_rate() const {
+    return proposals == 0
+               ? 0.
+               : static_cast<double>(accepted) / static_cast<double>(proposals);
+  }
+
+  // Mean of min(1, exp(-delta_S)), a lower variance estimate of the acceptance rate
+  double mean_acceptance_probability() const {
+    const auto n = delta_S.count() + non_finite;
+    return n == 0 ? 0. : acceptance_probability_sum / static_cast<double>(n);
+  }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(proposals, accepted, rejected, non_finite, delta_S, min_delta_S,
+                     max_delta_S, histogram, acceptance_probability_sum);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(proposals, accepted, rejected, non_finite, delta_S, min_delta_S,
+                    max_delta_S, histogram, acceptance_probability_sum);
+  }
+
+  // Lower edge of histogram bin i = 1, ..., n_bins
+  static double bin_lower_edge(std::size_t i) {
+    return histogram_min + (histogram_max - histogram_min) *
+                               static_cast<double>(i - 1) / static_cast<double>(n_bins);
+  }
+
+private:
+  static std::size_t bin(double x) {
+    if (x < histogram_min)
+      return 0;
+    if (x >= histogram_max)
+      return n_bins + 1;
+
+    const auto scaled = (x - histogram_min) / (histogram_max - histogram_min);
+    return 1 + std::min(n_bins - 1, static_cast<std::size_t>(scaled * n_bins));
+  }
+};
+
+} // namespace mlmcpi
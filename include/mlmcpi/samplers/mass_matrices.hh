@@ -0,0 +1,126 @@
+#pragma once
+
+#include "mlmcpi/common/circulant.hh"
+#include "mlmcpi/common/math.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Mass matrices M for the kinetic term 0.5 * p^T M^{-1} p of HMC. A mass matrix provides
+  - transform_noise(p): turns a vector of standard normal samples into p ~ N(0, M)
+  - velocity(p, v): computes v = M^{-1} p
+  - kinetic_energy(p): returns 0.5 * p^T M^{-1} p
+  `is_identity` allows the integrator to use fused updates for the default case.
+  Mass matrices with `is_adaptive` set provide set_variances(var) and are estimated
+  from the position variances during the adaptation phase of the sampler.
+ */
+template <typename PathType> struct identity_mass {
+  static constexpr bool is_identity = true;
+  static constexpr bool is_adaptive = false;
+
+  void transform_noise(PathType &) {}
+
+  void velocity(const PathType &p, PathType &v) { v = p; }
+
+  double kinetic_energy(const PathType &p) { return 0.5 * sqrNorm(p); }
+};
+
+/*
+  Circulant mass matrix, applied via FFT. Choosing M equal to the (circulant) Hessian of a
+  Gaussian action makes all Fourier modes evolve with the same frequency ("Fourier
+  acceleration"), which removes the critical slowing down caused by the spread between
+  the stiffest and the softest modes.
+ */
+template <typename PathType> class circulant_mass {
+public:
+  static constexpr bool is_identity = false;
+  static constexpr bool is_adaptive = false;
+
+  explicit circulant_mass(const std::vector<double> &kernel)
+      : op{kernel},
+        sqrt_spectrum{op.spectrum_power(0.5)},
+        inv_spectrum{op.spectrum_power(-1.)},
+        scratch(kernel.size()) {
+    for ([[maybe_unused]] const auto lambda : op.get_eigenvalues())
+      assert(lambda > 0 && "Mass matrix must be positive definite");
+  }
+
+  void transform_noise(PathType &p) { op.apply_spectral(p, p, sqrt_spectrum); }
+
+  void velocity(const PathType &p, PathType &v) { op.apply_spectral(p, v, inv_spectrum); }
+
+  double kinetic_energy(const PathType &p) {
+    op.apply_spectral(p, scratch, inv_spectrum);
+
+    double res = 0;
+    for (std::size_t i = 0; i < p.size(); ++i)
+      res += p[i] * scratch[i];
+    return 0.5 * res;
+  }
+
+private:
+  circulant_operator op;
+  std::vector<double> sqrt_spectrum;
+  std::vector<double> inv_spectrum;
+  std::vector<double> scratch;
+};
+
+/*
+  Diagonal mass matrix. Setting M^{-1} to the (estimated) variances of the target
+  equalises the scales of the individual components.
+ */
+template <typename PathType> class diagonal_mass {
+public:
+  static constexpr bool is_identity = false;
+  static constexpr bool is_adaptive = true;
+
+  explicit diagonal_mass(std::size_t n) : inv_mass(n, 1.), sqrt_mass(n, 1.) {}
+
+  void set_variances(const std::vector<double> &variances) {
+    assert(variances.size() == inv_mass.size());
+    for (std::size_t i = 0; i < variances.size(); ++i) {
+      assert(variances[i] > 0);
+      inv_mass[i] = variances[i];
+      sqrt_mass[i] = 1. / std::sqrt(variances[i]);
+    }
+  }
+
+  void transform_noise(PathType &p) {
+    for (std::size_t i = 0; i < p.size(); ++i)
+      p[i] *= sqrt_mass[i];
+  }
+
+  void velocity(const PathType &p, PathType &v) {
+    for (std::size_t i = 0; i < p.size(); ++i)
+      v[i] = inv_mass[i] * p[i];
+  }
+
+  double kinetic_energy(const PathType &p) {
+    double res = 0;
+    for (std::size_t i = 0; i < p.size(); ++i)
+      res += inv_mass[i] * p[i] * p[i];
+    return 0.5 * res;
+  }
+
+  const std::vector<double> &get_inverse_diagonal() const { return inv_mass; }
+
+  // Checkpointing, see checkpoint.hh
+  template <typename Writer> void save(Writer &writer) const {
+    writer.write_all(inv_mass, sqrt_mass);
+  }
+
+  template <typename Reader> void load(Reader &reader) {
+    reader.read_all(inv_mass, sqrt_mass);
+  }
+
+private:
+  std::vector<double> inv_mass;
+  std::vector<double> sqrt_mass;
+};
+
+} // namespace mlmcpi
@@ -1,13 +1,16 @@
 #pragma once
 
 #include "mlmcpi/common/partition.hh"
+#include "mlmcpi/samplers/level_statistics.hh"
+#include "mlmcpi/samplers/sampler.hh"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <memory>
-#include <optional>
 #include <random>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace mlmcpi {
@@ -21,7 +24,8 @@ struct multilevel_sampler {
                      OddEvenCondFactory &odd_even_factory_, Engine &engine_)
       : levels{levels_},
         coarse_sampler{coarse_sampler_},
-        engine{engine_} {
+        engine{engine_},
+        level_stats(levels_) {
     assert(levels > 2);
 
     actions.push_back(coarsest_action_);
@@ -32,6 +36,46 @@ struct multilevel_sampler {
       odd_even_conditionals.emplace_back(odd_even_factory_(actions[l]));
   }
 
+  /*
+    The state holds the whole hierarchy. Only the finest path is stored, the path on
+    level l consists of every 2^(L-1-l)-th site of it and is accessed through a strided
+    view (see partition.hh). In addition, the state caches the action on the levels
+    1, ..., L-1 (`action` being the one on the finest level), the conditional log
+    densities of the odd modes on these levels and the state of the coarse sampler, which
+    holds a copy of the level 0 path and its action.
+   */
+  struct State {
+    PathType path;
+    double action = 0;
+    std::vector<double> level_actions;
+    std::vector<double> conditional_log_densities;
+
+    typename CoarseSampler::State coarse;
+  };
+
+  State make_state(const PathType &path) {
+    assert(path.size() == actions[levels - 1].get_path_length());
+
+    State state;
+    state.path = path;
+    state.level_actions.resize(levels);
+    state.conditional_log_densities.resize(levels);
+
+    for (std::size_t level = 1; level < levels; ++level) {
+      const auto sites = sub_lattice(state.path, stride_on_level(level));
+      state.level_actions[level] = actions[level].evaluate(sites);
+      state.conditional_log_densities[level] =
+          odd_even_conditionals[level - 1].log_density(sites);
+    }
+
+    PathType coarse_path(actions[0].get_path_length());
+    assign_sites(sub_lattice(state.path, stride_on_level(0)), coarse_path);
+    state.coarse = coarse_sampler.make_state(coarse_path);
+    state.action = state.level_actions[levels - 1];
+
+    return state;
+  }
+
   /*
     One step consists of the following:
     - For each level repeat:
@@ -39,72 +83,125 @@ struct multilevel_sampler {
       - If this sample is rejected, stop and reject
       - Otherwise, fill in the fine modes
       - Compute the acceptance probability and perform MH-AR step
+    The proposal is assembled in place in the workspace: the coarse proposal is written
+    to the sites of level 0 and every level fills in its odd sites, so no level is
+    copied. All values for the current state are taken from its cache. An accepted
+    proposal is swapped into the current state; after a rejection on a level above 0,
+    the accepted step of the coarse sampler is undone by swapping the coarse states back.
    */
-
-  std::optional<PathType> perform_step(const PathType &current) {
-    assert(current.size() == actions[levels - 1].get_path_length());
-
-    std::vector<PathType> current_on_level;
-    current_on_level.push_back(current);
-    for (std::size_t level = 0; level < levels - 1; ++level) {
-      const auto [_, coarse_modes] = partition_odd_even(current_on_level[level]);
-      current_on_level.push_back(coarse_modes);
+  bool step(State &current, State &workspace) {
+    assert(current.path.size() == actions[levels - 1].get_path_length());
+
+    // Compute coarse proposal on level 0, which then is in current.coarse
+    const bool coarse_accepted = coarse_sampler.step(current.coarse, workspace.coarse);
+    level_stats[0].add(coarse_accepted);
+    if (not coarse_accepted)
+      return false;
+
+    auto &proposal = workspace;
+    assign_sites(current.coarse.path, sub_lattice(proposal.path, stride_on_level(0)));
+
+    for (std::size_t level = 1; level < levels; ++level) {
+      const auto sites = sub_lattice(proposal.path, stride_on_level(level));
+      auto &conditional = odd_even_conditionals[level - 1];
+
+      conditional.sample_odd_sites(sites);
+      proposal.conditional_log_densities[level] = conditional.log_density(sites);
+
+      const auto coarse_action_diff =
+          level == 1
+              ? workspace.coarse.action - current.coarse.action
+              : current.level_actions[level - 1] - proposal.level_actions[level - 1];
+
+      if (should_reject(level, sites, current, proposal, coarse_action_diff)) {
+        std::swap(current.coarse, workspace.coarse);
+        return false;
+      }
     }
-    std::reverse(current_on_level.begin(), current_on_level.end());
 
-    assert(current_on_level[0].size() == actions[0].get_path_length());
+    proposal.action = proposal.level_actions[levels - 1];
 
-    // Compute coarse proposal on level 0
-    const auto current_proposal_opt = coarse_sampler.perform_step(current_on_level[0]);
-    if (not current_proposal_opt)
-      return {};
+    // The coarse states are already in place
+    std::swap(current.path, proposal.path);
+    std::swap(current.action, proposal.action);
+    std::swap(current.level_actions, proposal.level_actions);
+    std::swap(current.conditional_log_densities, proposal.conditional_log_densities);
+    return true;
+  }
 
-    auto current_proposal = current_proposal_opt.value();
+  std::size_t get_finest_path_length() const {
+    return actions[levels - 1].get_path_length();
+  }
 
-    for (std::size_t prev_level = 0; prev_level < levels - 1; ++prev_level) {
-      auto fine_modes = odd_even_conditionals.at(prev_level).sample(current_proposal);
-      current_proposal = combine_odd_even(fine_modes, current_proposal);
+  Action get_action(std::size_t level) const { return actions[level]; }
 
-      if (should_reject(prev_level, current_proposal, current_on_level.at(prev_level + 1),
-                        fine_modes))
-        return {};
-    }
+  /*
+    Acceptance diagnostics per level, see level_statistics.hh: level 0 counts the steps
+    of the coarse sampler, level l > 0 the delayed acceptance step on level l. Together
+    they show on which level proposals are rejected. They include the burn-in unless
+    they are reset after it.
+   */
+  const std::vector<level_statistics> &get_level_statistics() const {
+    return level_stats;
+  }
+  void reset_level_statistics() { level_stats.assign(levels, level_statistics()); }
 
-    assert(current.size() == current_proposal.size());
-    return current_proposal;
+  // Only the coarse sampler has parameters to tune
+  void start_adaptation(std::size_t n_adaptation_steps)
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.start_adaptation(n_adaptation_steps);
   }
 
-  std::size_t get_finest_path_length() const {
-    return actions[levels - 1].get_path_length();
+  void stop_adaptation()
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.stop_adaptation();
   }
 
-  Action get_action(std::size_t level) const { return actions[level]; }
+  // Checkpointing (see checkpoint.hh) of the coarse sampler and the level statistics
+  template <typename Writer> void save(Writer &writer) const {
+    if constexpr (requires { coarse_sampler.save(writer); })
+      writer.write(coarse_sampler);
+    writer.write(level_stats);
+  }
 
-private:
-  bool should_reject(std::size_t level, const PathType &current_proposal,
-                     const PathType &current_sample, const PathType &coarse_proposal) {
-    auto [_, current_even] = partition_odd_even(current_sample);
+  template <typename Reader> void load(Reader &reader) {
+    if constexpr (requires { coarse_sampler.load(reader); })
+      reader.read(coarse_sampler);
+    reader.read(level_stats);
+  }
 
-    const auto fine_action_diff = actions[level + 1].evaluate(current_proposal) -
-                                  actions[level + 1].evaluate(current_sample);
+private:
+  // Distance between two sites of level `level` on the finest level
+  std::size_t stride_on_level(std::size_t level) const {
+    return std::size_t{1} << (levels - 1 - level);
+  }
 
-    const auto conditional_diff =
-        odd_even_conditionals[level].log_density(current_sample) -
-        odd_even_conditionals[level].log_density(current_proposal);
+  /*
+    Metropolis-Hastings test on `level`, given that the proposal was accepted on all
+    coarser levels. Evaluates the action of the proposal on this level, which is needed
+    on the next finer level if the proposal is accepted.
+   */
+  bool should_reject(std::size_t level, const strided_view<PathType> &sites,
+                     const State &current, State &proposal, double coarse_action_diff) {
+    const auto conditional_diff = current.conditional_log_densities[level] -
+                                  proposal.conditional_log_densities[level];
 
-    const auto coarse_action_diff =
-        actions[level].evaluate(current_even) - actions[level].evaluate(coarse_proposal);
+    // delta_S = proposal.level_actions[level] + known_diff
+    const auto known_diff =
+        conditional_diff + coarse_action_diff - current.level_actions[level];
 
-    const auto delta_S = fine_action_diff + conditional_diff + coarse_action_diff;
+    proposal.level_actions[level] = actions[level].evaluate(sites);
+    const auto delta_S = proposal.level_actions[level] + known_diff;
 
-    if (delta_S < 0)
-      return false; // accept
+    bool accept = true;
+    // NaN is rejected, see two_level_sampler
+    if (not(delta_S < 0))
+      accept = unif_dist(engine) < std::exp(-delta_S);
 
-    const auto acceptance_prob = std::exp(-delta_S);
-    if (unif_dist(engine) < acceptance_prob)
-      return false; // accept
-    else
-      return true; // reject
+    level_stats[level].add(delta_S, accept);
+    return not accept;
   }
 
   const std::size_t levels;
@@ -116,6 +213,8 @@ private:
 
   Engine &engine;
   std::uniform_real_distribution<double> unif_dist;
+
+  std::vector<level_statistics> level_stats;
 };
 
 } // namespace mlmcpi
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "mlmcpi/common/circulant.hh"
+
+#ifdef USE_BLAZE
+#include <blaze/Blaze.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace mlmcpi {
+
+/*
+  Covariance matrices Sigma of the Gaussian random walk proposal y = x + xi,
+  xi ~ N(0, Sigma). A covariance provides transform_noise(xi), which turns a vector of
+  standard normal samples into xi ~ N(0, Sigma) by applying a factor of Sigma. The
+  proposal is symmetric, q(y | x) = q(x | y), so the sampler never needs its density.
+ */
+
+// Sigma = diag(variances), O(n)
+template <typename PathType> class diagonal_covariance {
+public:
+  diagonal_covariance(std::size_t n, double variance)
+      : diagonal_covariance(std::vector<double>(n, variance)) {}
+
+  explicit diagonal_covariance(const std::vector<double> &variances)
+      : std_devs(variances.size()) {
+    for (std::size_t i = 0; i < variances.size(); ++i) {
+      assert(variances[i] > 0);
+      std_devs[i] = std::sqrt(variances[i]);
+    }
+  }
+
+  void transform_noise(PathType &xi) const {
+    for (std::size_t i = 0; i < xi.size(); ++i)
+      xi[i] *= std_devs[i];
+  }
+
+private:
+  std::vector<double> std_devs;
+};
+
+/*
+  Symmetric positive definite band matrix with `bandwidth` sub-diagonals, given by its
+  lower bands: bands[k][i] = Sigma_{i + k, i} for k = 0, ..., bandwidth. The Cholesky
+  factor has the same band structure, so it is computed in O(n b^2) and applied in
+  O(n b).
+ */
+template <typename PathType> class banded_covariance {
+public:
+  explicit banded_covariance(const std::vector<std::vector<double>> &bands)
+      : n{bands.at(0).size()},
+        bandwidth{bands.size() - 1},
+        factor(n * (bandwidth + 1), 0.) {
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto first = i > bandwidth ? i - bandwidth : 0;
+      for (std::size_t j = first; j <= i; ++j) {
+        assert(bands[i - j].size() + (i - j) >= n);
+
+        double sum = bands[i - j][j];
+        for (std::size_t k = first; k < j; ++k)
+          sum -= entry(i, k) * entry(j, k);
+
+        if (i == j) {
+          assert(sum > 0 && "Covariance matrix must be positive definite");
+          entry(i, i) = std::sqrt(sum);
+        } else {
+          entry(i, j) = sum / entry(j, j);
+        }
+      }
+    }
+  }
+
+  // xi <- L xi; traversed from the back so that the update can be done in place
+  void transform_noise(PathType &xi) const {
+    for (std::size_t i = n; i-- > 0;) {
+      double sum = 0;
+      for (std::size_t j = i > bandwidth ? i - bandwidth : 0; j <= i; ++j)
+        sum += entry(i, j) * xi[j];
+      xi[i] = sum;
+    }
+  }
+
+private:
+  // L_{ij} for i - bandwidth <= j <= i
+  double &entry(std::size_t i, std::size_t j) {
+    return factor[i * (bandwidth + 1) + i - j];
+  }
+  double entry(std::size_t i, std::size_t j) const {
+    return factor[i * (bandwidth + 1) + i - j];
+  }
+
+  std::size_t n;
+  std::size_t bandwidth;
+  std::vector<double> factor;
+};
+
+// Tridiagonal Sigma with the given diagonal and sub-diagonal (of length n - 1)
+template <typename PathType>
+banded_covariance<PathType>
+tridiagonal_covariance(const std::vector<double> &diagonal,
+                       const std::vector<double> &sub_diagonal) {
+  assert(sub_diagonal.size() + 1 == diagonal.size());
+  return banded_covariance<PathType>({diagonal, sub_diagonal});
+}
+
+/*
+  Symmetric positive definite circulant Sigma, defined by its first column (see
+  circulant.hh). Noise is transformed with the symmetric square root Sigma^{1/2} in
+  O(n log n).
+ */
+template <typename PathType> class circulant_covariance {
+public:
+  explicit circulant_covariance(const std::vector<double> &kernel)
+      : op{kernel},
+        sqrt_spectrum{op.spectrum_power(0.5)} {
+    for (const auto lambda : op.get_eigenvalues())
+      assert(lambda > 0 && "Covariance matrix must be positive definite");
+  }
+
+  void transform_noise(PathType &xi) { op.apply_spectral(xi, xi, sqrt_spectrum); }
+
+private:
+  circulant_operator op;
+  std::vector<double> sqrt_spectrum;
+};
+
+#ifdef USE_BLAZE
+/*
+  General dense Sigma. The Cholesky factor is computed once with LAPACK; transforming
+  noise costs O(n^2).
+ */
+template <typename PathType> class dense_covariance {
+public:
+  explicit dense_covariance(const blaze::DynamicMatrix<double> &sigma)
+      : chol_L{sigma} {
+    assert(sigma.rows() == sigma.columns());
+    blaze::potrf(chol_L, 'L'); // Only the lower part holds the Cholesky factor
+  }
+
+  // xi <- L xi, in place by traversing the rows from the back
+  void transform_noise(PathType &xi) const {
+    for (std::size_t i = chol_L.rows(); i-- > 0;) {
+      double sum = 0;
+      for (std::size_t j = 0; j <= i; ++j)
+        sum += chol_L(i, j) * xi[j];
+      xi[i] = sum;
+    }
+  }
+
+private:
+  blaze::DynamicMatrix<double> chol_L;
+};
+#endif
+
+} // namespace mlmcpi
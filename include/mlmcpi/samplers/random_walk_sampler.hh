@@ -1,78 +1,63 @@
 #pragma once
 
+#include "mlmcpi/common/random.hh"
+#include "mlmcpi/samplers/proposal_covariances.hh"
 #include "mlmcpi/samplers/sampler.hh"
 
-#ifndef USE_BLAZE
-#error random_walk_sampler can current only be used with blaze libraryUSE_BLAZE
-#endif
-#include <blaze/Blaze.h>
-
-#include <optional>
+#include <cmath>
 #include <random>
+#include <span>
+#include <utility>
 
 namespace mlmcpi {
-template <typename Action, typename MatrixType = blaze::DynamicMatrix<double>,
+/*
+  Random walk Metropolis-Hastings sampler with Gaussian proposals y = x + xi,
+  xi ~ N(0, Sigma). The structure of Sigma is a policy (see proposal_covariances.hh), so
+  a proposal costs O(n) for diagonal and banded, O(n log n) for circulant and O(n^2) for
+  dense covariances. The proposal is symmetric, so the acceptance probability only
+  depends on the action difference and is computed in log space.
+ */
+template <typename Action,
+          typename Covariance = diagonal_covariance<typename Action::PathType>,
           typename Engine = std::mt19937>
-struct random_walk_sampler : sampler<Action> {
+struct random_walk_sampler {
   using PathType = typename Action::PathType;
+  using State = sampler_state<PathType>;
 
-  random_walk_sampler(const MatrixType &sigma_, Action &action_, Engine &engine_)
-      : sigma{sigma_},
-        inv_sigma{blaze::inv(sigma)},
-        det_sigma{blaze::det(sigma)},
-        engine{std::move(engine_)},
-        action{std::move(action_)} {
-    cholL = sigma;
-    blaze::potrf(cholL, 'L'); // Compute Cholesky decomposition of Sigma
-  }
-
-  std::optional<PathType> perform_step(const PathType &current) override {
-    const auto proposal = generate_proposal(current);
+  random_walk_sampler(Covariance covariance_, Action &action_, Engine &engine_)
+      : covariance{std::move(covariance_)},
+        action{action_},
+        engine{engine_},
+        noise(action.get_path_length()) {}
 
-    const auto log_acceptance_prob =
-        action.evaluate(proposal) - action.evaluate(current) +
-        std::log(density(proposal, current)) - std::log(density(current, proposal));
-
-    if (log_acceptance_prob < 0)
-      return proposal;
-
-    auto acceptance_prob = std::exp(-log_acceptance_prob);
-    if (unif_dist(engine) < acceptance_prob)
-      return proposal;
-    else
-      return {};
-  }
+  State make_state(const PathType &path) { return {path, action.evaluate(path)}; }
 
-private:
-  [[nodiscard]] inline double density(const PathType &eval_point,
-                                      const PathType &mean) const {
-    const std::size_t k = mean.size();
+  bool step(State &current, State &workspace) {
+    fill_normal(engine, std::span<double>{noise.data(), noise.size()});
+    covariance.transform_noise(noise);
 
-    auto norm_factor = 1. / std::sqrt(std::pow(2 * M_PI, k) * det_sigma);
-    auto exp_term =
-        -0.5 * (blaze::trans(eval_point - mean) * inv_sigma * (eval_point - mean));
+    auto &proposal = workspace;
+    for (std::size_t i = 0; i < noise.size(); ++i)
+      proposal.path[i] = current.path[i] + noise[i];
+    proposal.action = action.evaluate(proposal.path);
 
-    return norm_factor * std::exp(exp_term);
-  }
+    // -log of the acceptance ratio pi(y) / pi(x)
+    const auto delta_S = proposal.action - current.action;
 
-  [[nodiscard]] inline PathType generate_proposal(const PathType &mean) {
-    blaze::DynamicVector<double> normal_samples(mean.size());
-    std::generate(normal_samples.begin(), normal_samples.end(),
-                  [&]() { return normal_dist(engine); });
-    return mean + blaze::decllow(sigma) * normal_samples;
+    const bool accept = delta_S < 0 || unif_dist(engine) < std::exp(-delta_S);
+    if (accept)
+      std::swap(current, workspace);
+    return accept;
   }
 
-  MatrixType sigma;
-  MatrixType inv_sigma;
-  double det_sigma;
-  MatrixType cholL; // Lower part of cholesky decomposition of sigma
-
-  Engine engine;
-  std::normal_distribution<double> normal_dist;
-
-  Action action;
+private:
+  Covariance covariance;
+  Action &action;
 
+  Engine &engine;
   std::uniform_real_distribution<double> unif_dist;
+
+  PathType noise;
 };
 
 } // namespace mlmcpi
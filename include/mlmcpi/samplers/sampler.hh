@@ -1,14 +1,75 @@
 #pragma once
 
-#include <optional>
+#include <concepts>
+#include <cstddef>
 
 namespace mlmcpi {
-template <typename Action> struct sampler {
-  using PathType = typename Action::PathType;
+/*
+  Samplers that tune their parameters (e.g., the HMC step size) while they are running.
+  Drivers call start_adaptation(n) before a burn-in phase of n steps and
+  stop_adaptation() after it, which freezes the tuned parameters.
+ */
+template <typename Sampler>
+concept adaptive_sampler = requires(Sampler &s, std::size_t n) {
+  s.start_adaptation(n);
+  s.stop_adaptation();
+};
+
+/*
+  Pair of chains on two neighbouring levels that is used for the correction terms of the
+  multilevel estimator (see coupled_level_sampler.hh). The state holds the fine chain
+  in `path` and the coarse chain in `coarse`; advance(state) moves both chains in place
+  and returns whether the fine proposal was accepted.
+ */
+template <typename Sampler>
+concept coupled_sampler = requires(Sampler &s, typename Sampler::State &state) {
+  { s.advance(state) } -> std::convertible_to<bool>;
+  state.path;
+  state.coarse.path;
+};
 
-  virtual std::optional<PathType> perform_step(const PathType &) = 0;
+/*
+  State of a chain: the path together with the value of the action the chain samples
+  from. Samplers that need more information about the current state (e.g., conditional
+  densities or coarse level actions) define their own state types, which also provide
+  `path` and `action`. All cached values are computed once when a state is created, so a
+  rejected proposal does not cause the current state to be evaluated again.
+ */
+template <typename PathType> struct sampler_state {
+  PathType path;
+  double action = 0;
+};
+
+/*
+  Samplers advance a chain in place: step(current, workspace) performs one step from
+  `current` and returns whether its proposal was accepted. `workspace` is a second state
+  of the same sampler (e.g., a copy of the initial state), in which the proposal is
+  assembled. If the proposal is accepted, `current` holds it afterwards and `workspace`
+  the previous state, which lets delayed acceptance samplers undo the step of their
+  coarse sampler. Otherwise `current` is unchanged and `workspace` holds no meaningful
+  state. Paths are exchanged by swapping, so a step copies no paths and, once the
+  buffers have their final size, allocates no memory.
 
-  virtual ~sampler() = default;
+  Samplers are plain types checked by this concept rather than implementations of a
+  virtual interface, so drivers call their steps directly and the whole sampler stack
+  (e.g., a multilevel sampler with an HMC coarse sampler) can be inlined.
+ */
+template <typename Sampler>
+concept mcmc_sampler = requires(Sampler &s, const typename Sampler::PathType &path,
+                                typename Sampler::State &state) {
+  { s.make_state(path) } -> std::same_as<typename Sampler::State>;
+  { s.step(state, state) } -> std::convertible_to<bool>;
 };
 
+// Performs `n` steps and returns the number of accepted proposals
+template <mcmc_sampler Sampler>
+std::size_t run_steps(Sampler &sampler, typename Sampler::State &current,
+                      typename Sampler::State &workspace, std::size_t n) {
+  std::size_t n_accepted = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    if (sampler.step(current, workspace))
+      n_accepted++;
+  return n_accepted;
+}
+
 } // namespace mlmcpi
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "mlmcpi/common/partition.hh"
+#include "mlmcpi/samplers/level_statistics.hh"
+#include "mlmcpi/samplers/sampler.hh"
 
+#include <cmath>
 #include <memory>
-#include <optional>
 #include <random>
+#include <utility>
+#include <vector>
 
 namespace mlmcpi {
 template <typename Action, typename CoarseSampler, typename OddEvenConditional,
@@ -17,54 +21,137 @@ struct two_level_sampler {
       : action{action_},
         coarse_sampler{coarse_sampler_},
         odd_even_conditional{odd_even_conditional_},
-        engine{engine_} {}
+        engine{engine_},
+        level_stats(2) {}
+
+  /*
+    In addition to the path and its action, the state caches the conditional log density
+    of the odd modes and the state of the coarse sampler for the even modes, which
+    includes their coarse action.
+   */
+  struct State {
+    PathType path;
+    double action = 0;
+    double conditional_log_density = 0;
+    typename CoarseSampler::State coarse;
+  };
+
+  State make_state(const PathType &path) {
+    PathType even(path.size() / 2);
+    assign_sites(even_sites(path), even);
+    return {path, action.evaluate(path), odd_even_conditional.log_density(path),
+            coarse_sampler.make_state(even)};
+  }
 
-  std::optional<PathType> perform_step(const PathType &current) {
-    /* Step 1: Generate coarse-level proposal */
-    auto [_, current_even] = partition_odd_even(current);
-    auto coarse_proposal_opt = coarse_sampler.perform_step(current_even);
+  /*
+    The fine proposal is assembled in the workspace. On rejection on either level, the
+    current state is left as it was, which for a rejection on the fine level means
+    undoing the accepted coarse step by swapping the coarse states back.
+   */
+  bool step(State &current, State &workspace) {
+    /* Step 1: Generate coarse-level proposal. If it is accepted, current.coarse holds it
+     * and workspace.coarse the current coarse state */
+    const bool coarse_accepted = coarse_sampler.step(current.coarse, workspace.coarse);
 
     // If coarse proposal is already rejected, we don't even check if it would be accepted
     // but just reject here
-    if (not coarse_proposal_opt)
-      return {};
-
-    auto coarse_proposal = coarse_proposal_opt.value();
+    level_stats[0].add(coarse_accepted);
+    if (not coarse_accepted)
+      return false;
 
     /* Step 2: "Inform" fine level about the (accepted) coarse-level proposal and perform
-     * Metropolis-Hastings step. */
-    auto fine_proposal =
-        combine_odd_even(odd_even_conditional.sample(coarse_proposal), coarse_proposal);
-
-    const auto fine_action_diff =
-        action.evaluate(fine_proposal) - action.evaluate(current);
+     * Metropolis-Hastings step. Only the proposal has to be evaluated, all values for
+     * the current state are cached. */
+    auto &proposal = workspace;
+    assign_sites(current.coarse.path, even_sites(proposal.path));
+    odd_even_conditional.sample_odd_sites(proposal.path);
+    proposal.conditional_log_density = odd_even_conditional.log_density(proposal.path);
+
+    const auto conditional_diff =
+        current.conditional_log_density - proposal.conditional_log_density;
+
+    const auto coarse_action_diff = workspace.coarse.action - current.coarse.action;
+
+    // delta_S = proposal.action + known_diff
+    const auto known_diff = conditional_diff + coarse_action_diff - current.action;
+
+    const bool accept = fine_level_accepts(proposal, known_diff);
+
+    // The coarse states are already in place for an accepted proposal
+    if (accept) {
+      std::swap(current.path, proposal.path);
+      std::swap(current.action, proposal.action);
+      std::swap(current.conditional_log_density, proposal.conditional_log_density);
+    } else {
+      std::swap(current.coarse, workspace.coarse);
+    }
+    return accept;
+  }
 
-    const auto conditional_diff = odd_even_conditional.log_density(current) -
-                                  odd_even_conditional.log_density(fine_proposal);
+  /*
+    Acceptance diagnostics of the coarse sampler (level 0) and of the fine
+    Metropolis-Hastings step (level 1), see level_statistics.hh. They include the burn-in
+    unless they are reset after it.
+   */
+  const std::vector<level_statistics> &get_level_statistics() const {
+    return level_stats;
+  }
+  void reset_level_statistics() { level_stats.assign(2, level_statistics()); }
 
-    auto coarse_action = action.make_coarsened_action();
-    const auto coarse_action_diff =
-        coarse_action.evaluate(current_even) - coarse_action.evaluate(coarse_proposal);
+  // Only the coarse sampler has parameters to tune
+  void start_adaptation(std::size_t n_adaptation_steps)
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.start_adaptation(n_adaptation_steps);
+  }
 
-    const auto delta_S = fine_action_diff + conditional_diff + coarse_action_diff;
+  void stop_adaptation()
+    requires adaptive_sampler<CoarseSampler>
+  {
+    coarse_sampler.stop_adaptation();
+  }
 
-    if (delta_S < 0)
-      return fine_proposal;
+  // Checkpointing (see checkpoint.hh) of the coarse sampler and the level statistics
+  template <typename Writer> void save(Writer &writer) const {
+    if constexpr (requires { coarse_sampler.save(writer); })
+      writer.write(coarse_sampler);
+    writer.write(level_stats);
+  }
 
-    const auto acceptance_prob = std::exp(-delta_S);
-    if (unif_dist(engine) < acceptance_prob)
-      return fine_proposal; // accept
-    else
-      return {}; // reject
+  template <typename Reader> void load(Reader &reader) {
+    if constexpr (requires { coarse_sampler.load(reader); })
+      reader.read(coarse_sampler);
+    reader.read(level_stats);
   }
 
 private:
+  /*
+    Metropolis-Hastings test on the fine level, where delta_S = proposal.action +
+    known_diff. Evaluates the fine action of the proposal.
+   */
+  bool fine_level_accepts(State &proposal, double known_diff) {
+    proposal.action = action.evaluate(proposal.path);
+    const auto delta_S = proposal.action + known_diff;
+
+    bool accept = true;
+    // Also rejects NaN, e.g. inf - inf for a proposal the action overflows on
+    if (not(delta_S < 0)) {
+      const auto acceptance_prob = std::exp(-delta_S);
+      accept = unif_dist(engine) < acceptance_prob;
+    }
+
+    level_stats[1].add(delta_S, accept);
+    return accept;
+  }
+
   Action &action;
   CoarseSampler &coarse_sampler;
   OddEvenConditional &odd_even_conditional;
 
   Engine &engine;
   std::uniform_real_distribution<double> unif_dist;
+
+  std::vector<level_statistics> level_stats;
 };
 
 } // namespace mlmcpi